@@ -0,0 +1,112 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace adt {
+
+// Monotone priority queue for unsigned integer keys: the key of a pushed element
+// must not be less than the key of the last popped one (which is always the case
+// for Dijkstra with non-negative lengths). Elements are spread over buckets by the
+// highest bit in which their key differs from the last popped key, so each element
+// is moved between buckets at most once per bit instead of being sifted through a
+// binary heap on every operation.
+//
+// Interface and ordering mimic std::priority_queue<T, std::vector<T>, Cmp>: top()
+// is the greatest element w.r.t. Cmp. Cmp must order elements with smaller keys
+// after the ones with greater keys; elements with equal keys are ordered by Cmp.
+template<class T, class KeyOf, class Cmp>
+class radix_heap {
+    typedef typename std::decay<decltype(std::declval<KeyOf>()(std::declval<const T&>()))>::type key_type;
+    static_assert(std::is_unsigned<key_type>::value, "radix_heap requires unsigned keys");
+
+    static constexpr size_t BUCKET_CNT = std::numeric_limits<key_type>::digits + 1;
+
+    // Bucket 0 keeps the elements with the key equal to last_ as a binary heap
+    std::array<std::vector<T>, BUCKET_CNT> buckets_;
+    key_type last_;
+    size_t size_;
+    KeyOf key_of_;
+    Cmp cmp_;
+
+    size_t bucket(key_type key) const {
+        if (key == last_)
+            return 0;
+        return std::numeric_limits<unsigned long long>::digits - __builtin_clzll((unsigned long long)(key ^ last_));
+    }
+
+    // Makes bucket 0 non-empty by redistributing the first non-empty bucket
+    void pull() {
+        if (!buckets_[0].empty())
+            return;
+
+        size_t i = 1;
+        while (buckets_[i].empty())
+            ++i;
+
+        auto &from = buckets_[i];
+        last_ = key_of_(*std::min_element(from.begin(), from.end(),
+                                          [&](const T &a, const T &b) { return key_of_(a) < key_of_(b); }));
+        for (auto &e : from)
+            buckets_[bucket(key_of_(e))].push_back(std::move(e));
+        from.clear();
+        std::make_heap(buckets_[0].begin(), buckets_[0].end(), cmp_);
+    }
+
+public:
+    radix_heap(KeyOf key_of = KeyOf(), Cmp cmp = Cmp())
+            : last_(0), size_(0), key_of_(key_of), cmp_(cmp) {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    const T &top() {
+        VERIFY(size_);
+        pull();
+        return buckets_[0].front();
+    }
+
+    void push(T e) {
+        key_type key = key_of_(e);
+        VERIFY_MSG(key >= last_, "radix_heap is monotone, key " << key << " is less than " << last_);
+        size_t b = bucket(key);
+        buckets_[b].push_back(std::move(e));
+        if (b == 0)
+            std::push_heap(buckets_[0].begin(), buckets_[0].end(), cmp_);
+        size_ += 1;
+    }
+
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    void pop() {
+        VERIFY(size_);
+        pull();
+        std::pop_heap(buckets_[0].begin(), buckets_[0].end(), cmp_);
+        buckets_[0].pop_back();
+        size_ -= 1;
+    }
+
+    // Drops all the elements, but keeps the memory allocated
+    void clear() {
+        for (auto &b : buckets_)
+            b.clear();
+        last_ = 0;
+        size_ = 0;
+    }
+};
+
+}
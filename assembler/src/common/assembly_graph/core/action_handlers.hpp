@@ -17,6 +17,12 @@
 
 namespace omnigraph {
 
+template<typename EdgeId>
+struct MergeEvent {
+    std::vector<EdgeId> old_edges;
+    EdgeId new_edge;
+};
+
 /**
 * ActionHandler is base listening class for graph events. All structures and information storages
 * which are meant to synchronize with graph should use this structure. In order to make handler listen
@@ -119,6 +125,35 @@ public:
     virtual void HandleSplit(EdgeId /*old_edge*/, EdgeId /*new_edge_1*/,
                              EdgeId /*new_edge_2*/) { }
 
+    /**
+     * Batched events are triggered when a batch of modifications made to the graph at once (e.g.
+     * in the deferred mode) is reported. All merges of the batch are reported first, then
+     * deletions of edges and vertices, then additions of edges, each kind in the order of the
+     * modifications and together with the events of the conjugate elements. Edges both added
+     * and deleted within the batch are not reported as added. All the elements involved are
+     * accessible till the whole batch is handled. By default every event is handled separately.
+     * @param merges merges performed, in the order of the modifications
+     */
+    virtual void HandleMergeBatch(const std::vector<MergeEvent<EdgeId>> &merges) {
+        for (const auto &merge : merges)
+            HandleMerge(merge.old_edges, merge.new_edge);
+    }
+
+    virtual void HandleDeleteBatch(const std::vector<EdgeId> &edges) {
+        for (EdgeId e : edges)
+            HandleDelete(e);
+    }
+
+    virtual void HandleDeleteBatch(const std::vector<VertexId> &vertices) {
+        for (VertexId v : vertices)
+            HandleDelete(v);
+    }
+
+    virtual void HandleAddBatch(const std::vector<EdgeId> &edges) {
+        for (EdgeId e : edges)
+            HandleAdd(e);
+    }
+
     /**
      * Every thread safe descendant should override this method for correct concurrent graph processing.
      */
@@ -232,6 +267,14 @@ public:
     virtual void ApplySplit(Handler &handler, EdgeId old_edge,
                             EdgeId new_edge_1, EdgeId new_edge2) const = 0;
 
+    virtual void ApplyMergeBatch(Handler &handler, const std::vector<MergeEvent<EdgeId>> &merges) const = 0;
+
+    virtual void ApplyDeleteBatch(Handler &handler, const std::vector<EdgeId> &edges) const = 0;
+
+    virtual void ApplyDeleteBatch(Handler &handler, const std::vector<VertexId> &vertices) const = 0;
+
+    virtual void ApplyAddBatch(Handler &handler, const std::vector<EdgeId> &edges) const = 0;
+
     virtual ~HandlerApplier() {
     }
 };
@@ -282,6 +325,22 @@ public:
         handler.HandleSplit(old_edge, new_edge1, new_edge2);
     }
 
+    void ApplyMergeBatch(Handler &handler, const std::vector<MergeEvent<EdgeId>> &merges) const override {
+        handler.HandleMergeBatch(merges);
+    }
+
+    void ApplyDeleteBatch(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleDeleteBatch(edges);
+    }
+
+    void ApplyDeleteBatch(Handler &handler, const std::vector<VertexId> &vertices) const override {
+        handler.HandleDeleteBatch(vertices);
+    }
+
+    void ApplyAddBatch(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleAddBatch(edges);
+    }
+
 };
 
 /**
@@ -310,6 +369,19 @@ private:
         return rc_path;
     }
 
+    // Elements are followed by their conjugates
+    template<class ElementId>
+    std::vector<ElementId> WithConjugates(const std::vector<ElementId> &elements) const {
+        std::vector<ElementId> result;
+        result.reserve(2 * elements.size());
+        for (ElementId el : elements) {
+            result.push_back(el);
+            if (el != graph_.conjugate(el))
+                result.push_back(graph_.conjugate(el));
+        }
+        return result;
+    }
+
 public:
     PairedHandlerApplier(Graph &graph)
             : graph_(graph) {
@@ -383,6 +455,30 @@ public:
         }
     }
 
+    void ApplyMergeBatch(Handler &handler, const std::vector<MergeEvent<EdgeId>> &merges) const override {
+        std::vector<MergeEvent<EdgeId>> paired_merges;
+        paired_merges.reserve(2 * merges.size());
+        for (const auto &merge : merges) {
+            paired_merges.push_back(merge);
+            EdgeId rce = graph_.conjugate(merge.new_edge);
+            if (merge.new_edge != rce)
+                paired_merges.push_back({ RCPath(merge.old_edges), rce });
+        }
+        handler.HandleMergeBatch(paired_merges);
+    }
+
+    void ApplyDeleteBatch(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleDeleteBatch(WithConjugates(edges));
+    }
+
+    void ApplyDeleteBatch(Handler &handler, const std::vector<VertexId> &vertices) const override {
+        handler.HandleDeleteBatch(WithConjugates(vertices));
+    }
+
+    void ApplyAddBatch(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleAddBatch(WithConjugates(edges));
+    }
+
 private:
     DECL_LOGGER("PairedHandlerApplier")
 };
@@ -67,6 +67,12 @@ class CoverageIndex : public GraphActionHandler<Graph> {
         SetRawCoverage(edge, 0);
     }
 
+    // Edges deleted within a batch are destroyed right after it, while other
+    // handlers (e.g. coverage-ordered queues) could still look at their coverage
+    void HandleDeleteBatch(const std::vector<EdgeId> &) override {}
+
+    using GraphActionHandler<Graph>::HandleDeleteBatch;
+
     void HandleMerge(const std::vector<EdgeId>& old_edges, EdgeId new_edge) override {
         unsigned coverage = 0;
         for (auto it = old_edges.begin(); it != old_edges.end(); ++it) {
@@ -223,44 +223,54 @@ private:
 private:
     static constexpr unsigned ID_BIAS = 3;
 
+    // Objects are stored in place in the fixed-size chunks addressed directly
+    // by id, so no allocation is made per object and the objects with close
+    // ids are close in memory. Chunks never move, so the pointers stay valid
+    // while the storage grows.
     template<class T>
     class IdStorage {
+        static constexpr unsigned CHUNK_BITS = 12;
+        static constexpr uint64_t CHUNK_SIZE = 1ull << CHUNK_BITS;
+        typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
       public:
         typedef omnigraph::ReclaimingIdDistributor::id_iterator id_iterator;
         typedef T value_type;
 
         IdStorage(uint64_t bias = ID_BIAS)
                 : size_(0), bias_(bias), id_distributor_(bias) {
-            storage_.resize(id_distributor_.size() + bias_);
+            grow(id_distributor_.size() + bias_);
+        }
+
+        ~IdStorage() {
+            for (auto it = id_begin(); it != id_end(); ++it)
+                at(*it)->~T();
+            // Chunks are freed in bulk
         }
 
         id_iterator id_begin() const { return id_distributor_.begin(); }
         id_iterator id_end() const { return id_distributor_.end(); }
 
         void reserve(size_t sz) {
-            if (storage_.size() >= sz + bias_)
-                return;
-
-            id_distributor_.resize(sz);
-            storage_.resize(sz + bias_);
+            if (id_distributor_.size() < sz)
+                id_distributor_.resize(sz);
+            grow(sz + bias_);
         }
 
         // FIXME: Count!
         size_t size() const { return size_; }
 
         bool contains(uint64_t id) const {
-            return (id < storage_.size()) && storage_[id];
+            return id >= bias_ && id - bias_ < id_distributor_.size() &&
+                   id_distributor_.occupied(id);
         }
 
         template<typename... ArgTypes>
         uint64_t create(ArgTypes &&... args) {
             uint64_t id = id_distributor_.allocate();
 
-            while (storage_.size() < id + 1)
-                storage_.resize(storage_.size() * 2 + 1);
-
-            VERIFY(storage_[id] == nullptr);
-            storage_[id] = new T(std::forward<ArgTypes>(args)...);;
+            grow(id + 1);
+            new (at(id)) T(std::forward<ArgTypes>(args)...);
             size_ += 1;
 
             // INFO("Create " << vid1 << ":" << vid2);
@@ -269,31 +279,44 @@ private:
 
         template<typename... ArgTypes>
         uint64_t emplace(uint64_t at, ArgTypes &&... args) {
-            // One MUST call reserve before using emplace()
-            VERIFY(storage_.at(at) == nullptr);
+            // One MUST call reserve before using emplace(), chunks are not
+            // allocated here, so emplace() could be called concurrently
+            VERIFY(at >= bias_ && at - bias_ < id_distributor_.size() && at < capacity());
             VERIFY(!id_distributor_.occupied(at));
 
             id_distributor_.acquire(at);
-            storage_[at] = new T(std::forward<ArgTypes>(args)...);;
+            new (this->at(at)) T(std::forward<ArgTypes>(args)...);
             size_.fetch_add(1);
 
             // INFO("Create " << vid1 << ":" << vid2);
             return at;
         }
 
-        void erase(uint64_t id) {
-            auto *v = storage_[id];
+        // Returns the ids to be given out by the subsequent allocations. The ids
+        // are not acquired, so they could be used with emplace() concurrently,
+        // provided no objects are created in the meantime.
+        std::vector<uint64_t> free_ids(size_t count) {
+            std::vector<uint64_t> ids;
+            ids.reserve(count);
+            for (size_t i = 0; i < count; ++i)
+                ids.push_back(id_distributor_.allocate());
+            for (uint64_t id : ids)
+                id_distributor_.release(id);
+            reserve(id_distributor_.size());
+
+            return ids;
+        }
 
+        void erase(uint64_t id) {
             // INFO("Remove " << id << ":" << cid);
-            delete v;
+            at(id)->~T();
 
             id_distributor_.release(id);
-            storage_[id] = nullptr;
             size_ -= 1;
         }
 
         T* at(uint64_t id) const {
-            return storage_[id];
+            return reinterpret_cast<T*>(&chunks_[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)]);
         }
 
         uint64_t reserved() const { return id_distributor_.size(); }
@@ -302,8 +325,15 @@ private:
       private:
         std::atomic<size_t> size_;
         uint64_t bias_;
-        std::vector<T*> storage_;
+        std::vector<std::unique_ptr<Slot[]>> chunks_;
         omnigraph::ReclaimingIdDistributor id_distributor_;
+
+        uint64_t capacity() const { return chunks_.size() * CHUNK_SIZE; }
+
+        void grow(uint64_t sz) {
+            while (capacity() < sz)
+                chunks_.emplace_back(new Slot[CHUNK_SIZE]);
+        }
     };
 
     using VertexStorage = IdStorage<PairedVertex<DataMaster>>;
@@ -535,14 +565,24 @@ protected:
         return result;
     }
 
-    void HiddenDeleteEdge(EdgeId e) {
-        TRACE("Hidden delete edge " << e.int_id());
+    // Detaches the edge and its conjugate from the vertices, objects are left in the storage
+    void HiddenDetachEdge(EdgeId e) {
         EdgeId rcEdge = conjugate(e);
         VertexId rcStart = conjugate(edge(e)->end());
         VertexId start = conjugate(edge(rcEdge)->end());
         vertex(start)->RemoveOutgoingEdge(e);
         vertex(rcStart)->RemoveOutgoingEdge(rcEdge);
-        DestroyEdge(e, rcEdge);
+    }
+
+    // Destroys the detached edge and its conjugate
+    void HiddenDestroyEdge(EdgeId e) {
+        DestroyEdge(e, conjugate(e));
+    }
+
+    void HiddenDeleteEdge(EdgeId e) {
+        TRACE("Hidden delete edge " << e.int_id());
+        HiddenDetachEdge(e);
+        HiddenDestroyEdge(e);
     }
 
     void HiddenDeletePath(const std::vector<EdgeId>& edgesToDelete,
@@ -570,6 +610,16 @@ public:
     size_t vreserved() const { return vstorage_.reserved(); }
     size_t ereserved() const { return estorage_.reserved(); }
 
+    // Ids for the edges to be added concurrently (passed explicitly), no other
+    // edges could be added until they are used
+    std::vector<EdgeId> FreeEdgeIds(size_t count) {
+        std::vector<EdgeId> ids;
+        ids.reserve(count);
+        for (uint64_t id : estorage_.free_ids(count))
+            ids.push_back(id);
+        return ids;
+    }
+
     uint64_t min_id() const { return ID_BIAS; }
 
     bool contains(VertexId vertex) const {
@@ -1,42 +1,55 @@
 #include "id_distributor.hpp"
 
+#include <algorithm>
+
 using namespace omnigraph;
 
 uint64_t ReclaimingIdDistributor::next_free(uint64_t n) const {
-    for (size_t i = n; i < free_map_.size(); ++i) {
-        if (free_map_[i])
-            return i;
+    if (n >= size_)
+        return size_;
+
+    size_t word = n >> 6;
+    // Bits below n are treated as occupied
+    uint64_t free = ~load(word) & (-1ULL << (n & 63));
+    while (!free) {
+        if (++word == occupied_map_.size())
+            return size_;
+        free = ~load(word);
     }
 
-    return free_map_.size();
+    return std::min(uint64_t(word << 6) + __builtin_ctzll(free), uint64_t(size_));
 }
 
 void ReclaimingIdDistributor::resize(size_t sz) {
     //fprintf(stderr, "!!!RESIZE!!!! %llu\n", sz);
-    free_map_.resize(sz, true);
+    occupied_map_.resize((sz + 63) >> 6, 0);
+    // Positions past the end are never occupied
+    if (sz & 63)
+        occupied_map_.back() &= (uint64_t(1) << (sz & 63)) - 1;
+    size_ = sz;
 }
 
 uint64_t ReclaimingIdDistributor::allocate(uint64_t offset) {
     // First hint: see if we could find any spot after last allocated
     uint64_t hint = last_allocated_ + offset;
     uint64_t n = next_free(hint);
-    if (n == free_map_.size()) {
+    if (n == size_) {
         // No luck, start from the beginning
         n = next_free();
     }
 
     // Still no luck, resize
-    if (n == free_map_.size())
-        resize(free_map_.size() * 2);
+    if (n == size_)
+        resize(size_ * 2);
 
     last_allocated_ = n;
-    free_map_[n] = false;
+    acquire(n + bias_);
     return n + bias_;
 }
 
 size_t ReclaimingIdDistributor::free() const {
     size_t res = 0;
-    for (bool flag : free_map_)
-        res += flag;
-    return res;
+    for (size_t i = 0; i < occupied_map_.size(); ++i)
+        res += __builtin_popcountll(load(i));
+    return size_ - res;
 }
@@ -16,10 +16,13 @@
 
 namespace omnigraph {
 
+// Ids are tracked in a bitmap of atomically updated 64-bit words, so ids
+// could be acquired and released concurrently without any locks. Resizing
+// is not thread-safe.
 class ReclaimingIdDistributor {
   public:
     ReclaimingIdDistributor(uint64_t bias = 0, size_t initial_size = 1)
-            : last_allocated_(0), bias_(bias) {
+            : last_allocated_(0), bias_(bias), size_(0) {
         resize(initial_size);
     }
 
@@ -27,20 +30,19 @@ class ReclaimingIdDistributor {
     uint64_t allocate(uint64_t offset = 0);
     size_t free() const;
     size_t size() const {
-        return free_map_.size();
+        return size_;
     }
     bool occupied(uint64_t at) const {
-        return !free_map_[at - bias_];
+        uint64_t n = at - bias_;
+        return (load(n >> 6) >> (n & 63)) & 1;
     }
     void acquire(uint64_t at) {
-        // FIXME: "lock" only single bit
-#pragma omp critical
-        free_map_[at - bias_] = false;
+        uint64_t n = at - bias_;
+        __atomic_fetch_or(&occupied_map_[n >> 6], uint64_t(1) << (n & 63), __ATOMIC_RELAXED);
     }
     void release(uint64_t at) {
-        // FIXME: "lock" only single bit
-#pragma omp critical
-        free_map_[at - bias_] = true;
+        uint64_t n = at - bias_;
+        __atomic_fetch_and(&occupied_map_[n >> 6], ~(uint64_t(1) << (n & 63)), __ATOMIC_RELAXED);
     }
 
     void clear_state(void) { last_allocated_ = 0; }
@@ -51,33 +53,24 @@ class ReclaimingIdDistributor {
                                                       uint64_t> {
       public:
         id_iterator(uint64_t start,
-                    const std::vector<bool> &map,
-                    uint64_t bias)
-                : map_(map), bias_(bias), cur_(start) {
-            if (cur_ != NPOS && map_.get()[cur_])
-                cur_ = next_occupied(cur_);
+                    const ReclaimingIdDistributor &distributor)
+                : distributor_(&distributor), cur_(start) {
+            if (cur_ != NPOS && !distributor_->occupied(cur_ + distributor_->bias_))
+                cur_ = distributor_->next_occupied(cur_);
         }
 
       private:
         friend class boost::iterator_core_access;
 
         uint64_t dereference() const {
-            return cur_ + bias_;
-        }
-
-        uint64_t next_occupied(uint64_t n) const {
-            for (size_t i = n + 1; i < map_.get().size(); ++i) {
-                if (!map_.get()[i])
-                    return i;
-            }
-            return NPOS;
+            return cur_ + distributor_->bias_;
         }
 
         void increment() {
             if (cur_ == NPOS)
                 return;
 
-            cur_ = next_occupied(cur_);
+            cur_ = distributor_->next_occupied(cur_);
         }
 
         bool equal(const id_iterator &other) const {
@@ -85,16 +78,15 @@ class ReclaimingIdDistributor {
         }
 
       private:
-        static const uint64_t NPOS = -1ULL;
-        std::reference_wrapper<const std::vector<bool>> map_;
-        uint64_t bias_, cur_;
+        const ReclaimingIdDistributor *distributor_;
+        uint64_t cur_;
     };
 
     id_iterator begin() const {
-        return id_iterator(0, free_map_, bias_);
+        return id_iterator(0, *this);
     }
     id_iterator end() const {
-        return id_iterator(-1ULL, free_map_, bias_);
+        return id_iterator(NPOS, *this);
     }
     adt::iterator_range<id_iterator> ids() const {
         return adt::make_range(begin(), end());
@@ -103,12 +95,34 @@ class ReclaimingIdDistributor {
 
   private:
     friend class id_iterator;
+    static const uint64_t NPOS = -1ULL;
 
+    uint64_t load(size_t word) const {
+        return __atomic_load_n(&occupied_map_[word], __ATOMIC_RELAXED);
+    }
+
+    // First free position >= n, or size() if none
     uint64_t next_free(uint64_t n = 0) const;
+    // First occupied position > n, or NPOS if none
+    uint64_t next_occupied(uint64_t n) const {
+        n += 1;
+        if (n >= size_)
+            return NPOS;
+
+        size_t word = n >> 6;
+        uint64_t occupied = load(word) & (-1ULL << (n & 63));
+        while (!occupied) {
+            if (++word == occupied_map_.size())
+                return NPOS;
+            occupied = load(word);
+        }
+
+        return (word << 6) + __builtin_ctzll(occupied);
+    }
 
     uint64_t last_allocated_;
     uint64_t bias_;
-    std::vector<bool> free_map_;
+    size_t size_;
+    std::vector<uint64_t> occupied_map_;
 };
-
 }
@@ -11,6 +11,7 @@
 #include "graph_core.hpp"
 #include "graph_iterators.hpp"
 
+#include <algorithm>
 #include <vector>
 #include <set>
 #include <cstring>
@@ -35,11 +36,82 @@ public:
     typedef ConstEdgeIterator<ObservableGraph> ConstEdgeIt;
     typedef ActionHandler<VertexId, EdgeId> Handler;
 
+    /*
+     * Events of the modifications made by a thread in the deferred mode (see
+     * StartDeferring()). The graph is modified right away, but the events are
+     * stored to be fired later by FireDeferred() as a batch (see
+     * ActionHandler::HandleMergeBatch()). The elements deleted are only
+     * detached from the graph till then, so the handlers could access them as
+     * usual. New edges get the ids given in advance, so disjoint parts of the
+     * graph could be modified concurrently. Only deletions and merges are
+     * supported.
+     */
+    class DeferredEvents {
+      public:
+        DeferredEvents()
+                : graph_(nullptr), next_id_(0) {}
+
+        template<class It>
+        void set_edge_ids(It begin, It end) {
+            edge_ids_.assign(begin, end);
+            next_id_ = 0;
+        }
+
+      private:
+        friend class ObservableGraph;
+
+        enum class Type : uint8_t { AddEdge, DeleteEdge, DeleteVertex, Merge };
+
+        struct Event {
+            Type type;
+            // Number of the merged edges
+            uint32_t count;
+            uint64_t id;
+        };
+
+        const ObservableGraph *graph_;
+        std::vector<Event> events_;
+        std::vector<EdgeId> merged_;
+        std::vector<EdgeId> deleted_edges_;
+        std::vector<VertexId> deleted_vertices_;
+        std::vector<EdgeId> edge_ids_;
+        size_t next_id_;
+
+        void push(Type type, uint64_t id, size_t count = 0) {
+            events_.push_back({ type, uint32_t(count), id });
+        }
+
+        std::pair<EdgeId, EdgeId> next_edge_ids() {
+            VERIFY_MSG(next_id_ + 2 <= edge_ids_.size(), "Not enough edge ids given for deferred modifications");
+            next_id_ += 2;
+            return { edge_ids_[next_id_ - 2], edge_ids_[next_id_ - 1] };
+        }
+
+        void clear() {
+            events_.clear();
+            merged_.clear();
+            deleted_edges_.clear();
+            deleted_vertices_.clear();
+            edge_ids_.clear();
+            next_id_ = 0;
+        }
+    };
+
 private:
    //todo switch to smart iterators
    mutable std::vector<Handler*> action_handler_list_;
    std::unique_ptr<const HandlerApplier<VertexId, EdgeId>> applier_;
 
+   static thread_local DeferredEvents *deferred_;
+
+   DeferredEvents *deferred() const {
+       return (deferred_ && deferred_->graph_ == this) ? deferred_ : nullptr;
+   }
+
+   void RemoveEdge(EdgeId e);
+
+   void RemoveVertex(VertexId v);
+
 public:
 //todo move to graph core
     typedef ConstructionHelper<DataMaster> HelperT;
@@ -80,8 +152,21 @@ public:
 
     void FireSplit(EdgeId edge, EdgeId new_edge1, EdgeId new_edge2) const;
 
+    void FireBatch(const std::vector<MergeEvent<EdgeId>> &merges,
+                   const std::vector<EdgeId> &deleted_edges,
+                   const std::vector<VertexId> &deleted_vertices,
+                   const std::vector<EdgeId> &added_edges) const;
+
     bool VerifyAllDetached();
 
+    // Starts deferring the events of the modifications made by the current thread
+    void StartDeferring(DeferredEvents &events) const;
+
+    void StopDeferring() const;
+
+    // Fires the events deferred by all the threads as a single batch and destroys the elements deleted
+    void FireDeferred(std::vector<DeferredEvents> &events);
+
     //smart iterators
     template<typename Comparator>
     SmartVertexIterator<ObservableGraph, Comparator> SmartVertexBegin(
@@ -159,9 +244,93 @@ private:
     DECL_LOGGER("ObservableGraph")
 };
 
+template<class DataMaster>
+thread_local typename ObservableGraph<DataMaster>::DeferredEvents *ObservableGraph<DataMaster>::deferred_ = nullptr;
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::RemoveEdge(EdgeId e) {
+    if (DeferredEvents *events = deferred()) {
+        base::HiddenDetachEdge(e);
+        events->deleted_edges_.push_back(e);
+    } else {
+        base::HiddenDeleteEdge(e);
+    }
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::RemoveVertex(VertexId v) {
+    if (DeferredEvents *events = deferred())
+        events->deleted_vertices_.push_back(v);
+    else
+        base::HiddenDeleteVertex(v);
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::StartDeferring(DeferredEvents &events) const {
+    VERIFY(!deferred_);
+    events.graph_ = this;
+    deferred_ = &events;
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::StopDeferring() const {
+    VERIFY(deferred());
+    deferred_ = nullptr;
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::FireDeferred(std::vector<DeferredEvents> &events) {
+    VERIFY(!deferred());
+    typedef typename DeferredEvents::Type Type;
+    std::vector<MergeEvent<EdgeId>> merges;
+    std::vector<EdgeId> deleted_edges, added_edges;
+    std::vector<VertexId> deleted_vertices;
+    for (const auto &thread_events : events) {
+        auto merged = thread_events.merged_.begin();
+        for (const auto &event : thread_events.events_) {
+            switch (event.type) {
+                case Type::AddEdge:
+                    added_edges.push_back(EdgeId(event.id));
+                    break;
+                case Type::DeleteEdge:
+                    deleted_edges.push_back(EdgeId(event.id));
+                    break;
+                case Type::DeleteVertex:
+                    deleted_vertices.push_back(VertexId(event.id));
+                    break;
+                case Type::Merge:
+                    merges.push_back({ std::vector<EdgeId>(merged, merged + event.count), EdgeId(event.id) });
+                    merged += event.count;
+                    break;
+            }
+        }
+    }
+
+    // Edges created and merged once again within the batch are not reported as added
+    std::vector<EdgeId> sorted_deleted(deleted_edges);
+    std::sort(sorted_deleted.begin(), sorted_deleted.end());
+    auto deleted = [&](EdgeId e) {
+        return std::binary_search(sorted_deleted.begin(), sorted_deleted.end(), e);
+    };
+    added_edges.erase(std::remove_if(added_edges.begin(), added_edges.end(),
+                                     [&](EdgeId e) { return deleted(e) || deleted(conjugate(e)); }),
+                      added_edges.end());
+
+    FireBatch(merges, deleted_edges, deleted_vertices, added_edges);
+
+    for (auto &thread_events : events) {
+        for (EdgeId e : thread_events.deleted_edges_)
+            base::HiddenDestroyEdge(e);
+        for (VertexId v : thread_events.deleted_vertices_)
+            base::HiddenDeleteVertex(v);
+        thread_events.clear();
+    }
+}
+
 template<class DataMaster>
 typename ObservableGraph<DataMaster>::VertexId
 ObservableGraph<DataMaster>::AddVertex(const VertexData &data, VertexId id1, VertexId id2) {
+    VERIFY(!deferred());
     VertexId v = base::HiddenAddVertex(data, id1, id2);
     FireAddVertex(v);
     return v;
@@ -172,7 +341,7 @@ void ObservableGraph<DataMaster>::DeleteVertex(VertexId v) {
     VERIFY(base::IsDeadEnd(v) && base::IsDeadStart(v));
     VERIFY(v != VertexId());
     FireDeleteVertex(v);
-    base::HiddenDeleteVertex(v);
+    RemoveVertex(v);
 }
 
 template<class DataMaster>
@@ -186,6 +355,7 @@ template<class DataMaster>
 typename ObservableGraph<DataMaster>::EdgeId
 ObservableGraph<DataMaster>::AddEdge(VertexId v1, VertexId v2, const EdgeData &data,
                                      EdgeId id1, EdgeId id2) {
+    VERIFY(!deferred());
     EdgeId e = base::HiddenAddEdge(v1, v2, data, id1, id2);
     FireAddEdge(e);
     return e;
@@ -194,6 +364,7 @@ ObservableGraph<DataMaster>::AddEdge(VertexId v1, VertexId v2, const EdgeData &d
 template<class DataMaster>
 typename ObservableGraph<DataMaster>::EdgeId
 ObservableGraph<DataMaster>::AddEdge(const EdgeData& data, EdgeId id1, EdgeId id2) {
+    VERIFY(!deferred());
     EdgeId e = base::HiddenAddEdge(data, id1, id2);
     FireAddEdge(e);
     return e;
@@ -202,7 +373,7 @@ ObservableGraph<DataMaster>::AddEdge(const EdgeData& data, EdgeId id1, EdgeId id
 template<class DataMaster>
 void ObservableGraph<DataMaster>::DeleteEdge(EdgeId e) {
     FireDeleteEdge(e);
-    base::HiddenDeleteEdge(e);
+    RemoveEdge(e);
 }
 
 template<class DataMaster>
@@ -334,6 +505,10 @@ void ObservableGraph<DataMaster>::FireAddVertex(VertexId v) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireAddEdge(EdgeId e) const {
+    if (DeferredEvents *events = deferred()) {
+        events->push(DeferredEvents::Type::AddEdge, e.int_id());
+        return;
+    }
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
             TRACE("FireAddEdge to handler " << handler_ptr->name());
@@ -344,6 +519,10 @@ void ObservableGraph<DataMaster>::FireAddEdge(EdgeId e) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireDeleteVertex(VertexId v) const {
+    if (DeferredEvents *events = deferred()) {
+        events->push(DeferredEvents::Type::DeleteVertex, v.int_id());
+        return;
+    }
     for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
         if ((*it)->IsAttached()) {
             applier_->ApplyDelete(**it, v);
@@ -353,6 +532,10 @@ void ObservableGraph<DataMaster>::FireDeleteVertex(VertexId v) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireDeleteEdge(EdgeId e) const {
+    if (DeferredEvents *events = deferred()) {
+        events->push(DeferredEvents::Type::DeleteEdge, e.int_id());
+        return;
+    }
     for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
         if ((*it)->IsAttached()) {
             applier_->ApplyDelete(**it, e);
@@ -362,6 +545,11 @@ void ObservableGraph<DataMaster>::FireDeleteEdge(EdgeId e) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireMerge(const std::vector<EdgeId> &old_edges, EdgeId new_edge) const {
+    if (DeferredEvents *events = deferred()) {
+        events->push(DeferredEvents::Type::Merge, new_edge.int_id(), old_edges.size());
+        events->merged_.insert(events->merged_.end(), old_edges.begin(), old_edges.end());
+        return;
+    }
     for (Handler* handler_ptr : action_handler_list_) {
         if (handler_ptr->IsAttached()) {
             applier_->ApplyMerge(*handler_ptr, old_edges, new_edge);
@@ -387,6 +575,38 @@ void ObservableGraph<DataMaster>::FireSplit(EdgeId edge, EdgeId new_edge1, EdgeI
     }
 }
 
+template<class DataMaster>
+void ObservableGraph<DataMaster>::FireBatch(const std::vector<MergeEvent<EdgeId>> &merges,
+                                            const std::vector<EdgeId> &deleted_edges,
+                                            const std::vector<VertexId> &deleted_vertices,
+                                            const std::vector<EdgeId> &added_edges) const {
+    VERIFY(!deferred());
+    if (!merges.empty()) {
+        for (Handler* handler_ptr : action_handler_list_) {
+            if (handler_ptr->IsAttached())
+                applier_->ApplyMergeBatch(*handler_ptr, merges);
+        }
+    }
+
+    if (!deleted_edges.empty() || !deleted_vertices.empty()) {
+        for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
+            if (!(*it)->IsAttached())
+                continue;
+            if (!deleted_edges.empty())
+                applier_->ApplyDeleteBatch(**it, deleted_edges);
+            if (!deleted_vertices.empty())
+                applier_->ApplyDeleteBatch(**it, deleted_vertices);
+        }
+    }
+
+    if (!added_edges.empty()) {
+        for (Handler* handler_ptr : action_handler_list_) {
+            if (handler_ptr->IsAttached())
+                applier_->ApplyAddBatch(*handler_ptr, added_edges);
+        }
+    }
+}
+
 template<class DataMaster>
 bool ObservableGraph<DataMaster>::VerifyAllDetached() {
     for (Handler* handler_ptr : action_handler_list_) {
@@ -462,19 +682,27 @@ typename ObservableGraph<DataMaster>::EdgeId
     for (auto it = corrected_path.begin(); it != corrected_path.end(); ++it) {
         to_merge.push_back(&(base::data(*it)));
     }
-    EdgeId new_edge = base::HiddenAddEdge(v1, v2, base::master().MergeData(to_merge, safe_merging));
+    std::pair<EdgeId, EdgeId> ids;
+    if (DeferredEvents *events = deferred())
+        ids = events->next_edge_ids();
+    EdgeId new_edge = base::HiddenAddEdge(v1, v2, base::master().MergeData(to_merge, safe_merging),
+                                          ids.first, ids.second);
     FireMerge(corrected_path, new_edge);
     auto edges_to_delete = EdgesToDelete(corrected_path);
     auto vertices_to_delete = VerticesToDelete(corrected_path);
     FireDeletePath(edges_to_delete, vertices_to_delete);
     FireAddEdge(new_edge);
-    base::HiddenDeletePath(edges_to_delete, vertices_to_delete);
+    for (EdgeId e : edges_to_delete)
+        RemoveEdge(e);
+    for (VertexId v : vertices_to_delete)
+        RemoveVertex(v);
     return new_edge;
 }
 
 template<class DataMaster>
 std::pair<typename ObservableGraph<DataMaster>::EdgeId, typename ObservableGraph<DataMaster>::EdgeId>
         ObservableGraph<DataMaster>::SplitEdge(EdgeId edge, size_t position) {
+    VERIFY(!deferred());
     bool sc_flag = (edge == conjugate(edge));
     VERIFY_MSG(position > 0 && position < (sc_flag ? base::length(edge) / 2 + 1 : base::length(edge)),
             "Edge length is " << base::length(edge) << " but split pos was " << position);
@@ -494,6 +722,7 @@ std::pair<typename ObservableGraph<DataMaster>::EdgeId, typename ObservableGraph
 
 template<class DataMaster>
 typename ObservableGraph<DataMaster>::EdgeId ObservableGraph<DataMaster>::GlueEdges(EdgeId edge1, EdgeId edge2) {
+    VERIFY(!deferred());
     EdgeId new_edge = base::HiddenAddEdge(base::EdgeStart(edge2), base::EdgeEnd(edge2), base::master().GlueData(base::data(edge1), base::data(edge2)));
     FireGlue(new_edge, edge1, edge2);
     FireDeleteEdge(edge1);
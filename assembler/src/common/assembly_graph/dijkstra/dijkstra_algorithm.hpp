@@ -8,12 +8,14 @@
 
 #include "dijkstra_settings.hpp"
 
+#include "adt/radix_heap.hpp"
 #include "utils/stl_utils.hpp"
 #include "utils/logger/logger.hpp"
 
 #include <parallel_hashmap/phmap.h>
 
 #include <queue>
+#include <type_traits>
 #include <vector>
 
 namespace omnigraph {
@@ -51,6 +53,23 @@ public:
     }
 };
 
+// Queue used by Dijkstra with the given settings. Integer lengths go to the
+// radix heap, which pops the elements in exactly the same order as the binary
+// heap does; specialize for a particular settings class to override the choice.
+template<class DijkstraSettings, class Element, typename distance_t, class Enable = void>
+struct DijkstraQueue {
+    typedef std::priority_queue<Element, std::vector<Element>, ReverseDistanceComparator<Element>> type;
+};
+
+template<class DijkstraSettings, class Element, typename distance_t>
+struct DijkstraQueue<DijkstraSettings, Element, distance_t,
+                     typename std::enable_if<std::is_unsigned<distance_t>::value>::type> {
+    struct DistanceOf {
+        distance_t operator()(const Element &e) const { return e.distance; }
+    };
+    typedef adt::radix_heap<Element, DistanceOf, ReverseDistanceComparator<Element>> type;
+};
+
 template<class Graph, class DijkstraSettings, typename distance_t = size_t>
 class Dijkstra {
     typedef typename Graph::VertexId VertexId;
@@ -60,9 +79,7 @@ class Dijkstra {
 
     typedef phmap::flat_hash_map<VertexId, distance_t> distances_map;
     typedef typename distances_map::const_iterator distances_map_ci;
-    typedef typename std::priority_queue<queue_element,
-                                         std::vector<queue_element>,
-                                         ReverseDistanceComparator<queue_element>> queue_t;
+    typedef typename DijkstraQueue<DijkstraSettings, queue_element, distance_t>::type queue_t;
     // constructor parameters
     const Graph& graph_;
     DijkstraSettings settings_;
@@ -145,6 +145,11 @@ public:
         SetRawCoverage(e, 0);
     }
 
+    // See CoverageIndex::HandleDeleteBatch()
+    void HandleDeleteBatch(const std::vector<EdgeId> &) override {}
+
+    using base::HandleDeleteBatch;
+
     double LocalCoverage(EdgeId e, VertexId v) const {
         if (this->g().EdgeStart(e) == v) {
             return GetInCov(e);
@@ -318,11 +318,14 @@ template<class Graph, class ElementId,
 class PersistentProcessingAlgorithm : public PersistentAlgorithmBase<Graph> {
 protected:
     typedef std::shared_ptr<InterestingElementFinder<Graph, ElementId>> CandidateFinderPtr;
+    typedef typename Graph::VertexId VertexId;
     CandidateFinderPtr interest_el_finder_;
 
 private:
     SmartSetIterator<Graph, ElementId, Comparator> it_;
     const bool tracking_;
+    // Vertices reserved within the current round of the concurrent processing
+    std::vector<bool> reserved_;
 
 protected:
     void ReturnForConsideration(ElementId el) {
@@ -333,6 +336,15 @@ protected:
     virtual bool Proceed(ElementId /*el*/) const { return true; }
     virtual void PrepareIteration(double /*iter_run_progress*/ = 1.) {}
 
+    /*
+     * Algorithms supporting the concurrent processing provide the read-only
+     * Check() of Process(), which is run for the queued elements in parallel,
+     * and Locality(): the vertices whose incident edges Process() could modify.
+     */
+    virtual bool concurrent() const { return false; }
+    virtual void Locality(ElementId /*el*/, std::vector<VertexId> &/*locality*/) const { VERIFY(false); }
+    virtual bool Check(ElementId /*el*/) const { VERIFY(false); return false; }
+
 public:
 
     PersistentProcessingAlgorithm(Graph& g,
@@ -369,8 +381,18 @@ public:
         //PrepareIteration(std::min(curr_iteration_, total_iteration_estimate_ - 1), total_iteration_estimate_);
         PrepareIteration(iter_run_progress);
 
-        size_t triggered = 0;
         TRACE("Start processing");
+        size_t triggered = concurrent() && omp_get_max_threads() > 1 ? ProcessConcurrently() : ProcessSequentially();
+        TRACE("Finished processing. Triggered = " << triggered);
+        if (!tracking_)
+            it_.Detach();
+
+        return triggered;
+    }
+
+private:
+    size_t ProcessSequentially() {
+        size_t triggered = 0;
         for (; !it_.IsEnd(); ++it_) {
             ElementId el = *it_;
             if (!Proceed(el)) {
@@ -382,14 +404,86 @@ public:
             if (Process(el))
                 triggered++;
         }
-        TRACE("Finished processing. Triggered = " << triggered);
-        if (!tracking_)
-            it_.Detach();
+        return triggered;
+    }
+
+    /*
+     * Elements are processed in rounds. All the elements queued are checked in
+     * parallel, then the ones to process are chosen in the order of iteration:
+     * an element is processed if its locality does not intersect the
+     * localities of the preceding elements processed or postponed in this
+     * round, otherwise it is postponed till the next one. Elements failed the
+     * check are dropped unless postponed. Check() could look beyond the
+     * locality, so the chosen elements are processed as usual, re-checked on
+     * the graph modified by the preceding ones. Thus the result does not
+     * depend on the number of threads.
+     */
+    size_t ProcessConcurrently() {
+        Graph &g = this->g();
+        std::vector<ElementId> elements;
+        std::vector<VertexId> locality, reserved;
+        size_t triggered = 0;
+        bool proceed = true;
+        while (proceed && !it_.IsEnd()) {
+            elements.clear();
+            for (; !it_.IsEnd(); ++it_) {
+                ElementId el = *it_;
+                if (!Proceed(el)) {
+                    TRACE("Proceed condition turned false on element " << g.str(el));
+                    it_.ReleaseCurrent();
+                    proceed = false;
+                    break;
+                }
+                elements.push_back(el);
+            }
+
+            std::vector<char> passed(elements.size());
+            #pragma omp parallel for schedule(guided)
+            for (size_t i = 0; i < elements.size(); ++i)
+                passed[i] = Check(elements[i]);
+
+            size_t chosen = 0;
+            reserved_.resize(g.min_id() + g.vreserved());
+            for (size_t i = 0; i < elements.size(); ++i) {
+                ElementId el = elements[i];
+                locality.clear();
+                Locality(el, locality);
+                bool free = std::none_of(locality.begin(), locality.end(),
+                                         [&](VertexId v) { return reserved_[ReservationIdx(v)]; });
+                if (free && !passed[i])
+                    continue;
+
+                for (VertexId v : locality) {
+                    if (!reserved_[ReservationIdx(v)]) {
+                        reserved_[ReservationIdx(v)] = true;
+                        reserved.push_back(v);
+                    }
+                }
+                if (free)
+                    elements[chosen++] = el;
+                else
+                    it_.push(el);
+            }
+            for (VertexId v : reserved)
+                reserved_[ReservationIdx(v)] = false;
+            reserved.clear();
+            TRACE(elements.size() << " elements considered, " << chosen << " chosen");
+
+            // The localities are disjoint, so the elements chosen are still in the graph
+            for (size_t i = 0; i < chosen; ++i) {
+                TRACE("Processing edge " << g.str(elements[i]));
+                if (Process(elements[i]))
+                    triggered++;
+            }
+        }
 
         return triggered;
     }
 
-private:
+    size_t ReservationIdx(VertexId v) const {
+        return std::min(v, this->g().conjugate(v)).int_id();
+    }
+
     DECL_LOGGER("PersistentProcessingAlgorithm"); 
 };
 
@@ -401,6 +495,8 @@ class ParallelEdgeRemovingAlgorithm : public PersistentProcessingAlgorithm<Graph
     typedef typename Graph::EdgeId EdgeId;
     typedef PersistentProcessingAlgorithm<Graph, EdgeId, Comparator> base;
 
+    typedef typename Graph::VertexId VertexId;
+
     const func::TypedPredicate<EdgeId> remove_condition_;
     EdgeRemover<Graph> edge_remover_;
 
@@ -417,6 +513,25 @@ protected:
         return false;
     }
 
+    bool concurrent() const override { return true; }
+
+    // Removal compresses the ends of the edge, so the edges incident to them
+    // and to their neighbours could change
+    void Locality(EdgeId e, std::vector<VertexId> &locality) const override {
+        const Graph &g = this->g();
+        for (VertexId v : {g.EdgeStart(e), g.EdgeEnd(e)}) {
+            locality.push_back(v);
+            for (EdgeId in : g.IncomingEdges(v))
+                locality.push_back(g.EdgeStart(in));
+            for (EdgeId out : g.OutgoingEdges(v))
+                locality.push_back(g.EdgeEnd(out));
+        }
+    }
+
+    bool Check(EdgeId e) const override {
+        return remove_condition_(e);
+    }
+
 public:
     ParallelEdgeRemovingAlgorithm(Graph& g,
                                   func::TypedPredicate<EdgeId> remove_condition,
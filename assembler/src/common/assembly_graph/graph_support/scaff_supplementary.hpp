@@ -3,6 +3,7 @@
 #include "assembly_graph/core/graph.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "utils/logger/logger.hpp"
+#include "utils/parallel/thread_local_ptr.hpp"
 //FIXME
 #include "modules/path_extend/pe_utils.hpp"
 #include "modules/path_extend/pe_config_struct.hpp"
@@ -108,10 +109,52 @@ public:
 };
 
 class UsedUniqueStorage {
+public:
+    /*
+     * Edges used by a thread in the speculative mode (see StartSpeculation())
+     * are kept in the log instead of the storage, so that several paths could
+     * be grown concurrently and their edges committed later in the required
+     * order (see Commit()). The edges looked up in the storage are logged too,
+     * so one could check whether the edges committed since affect the result.
+     */
+    class SpeculationLog {
+      public:
+        SpeculationLog()
+                : storage_(nullptr) {}
+
+        const std::set<EdgeId> &used() const {
+            return used_;
+        }
+
+        const std::vector<EdgeId> &looked_up() const {
+            return looked_up_;
+        }
+
+        void clear() {
+            used_.clear();
+            looked_up_.clear();
+        }
+
+      private:
+        friend class UsedUniqueStorage;
+
+        const UsedUniqueStorage *storage_;
+        std::set<EdgeId> used_;
+        std::vector<EdgeId> looked_up_;
+    };
+
+private:
     std::set<EdgeId> used_;
     const ScaffoldingUniqueEdgeStorage& unique_;
     const debruijn_graph::ConjugateDeBruijnGraph &g_;
 
+    typedef utils::ThreadLocalPtr<SpeculationLog> CurrentLog;
+
+    SpeculationLog *log() const {
+        SpeculationLog *log = CurrentLog::get();
+        return (log && log->storage_ == this) ? log : nullptr;
+    }
+
 public:
     UsedUniqueStorage(const UsedUniqueStorage&) = delete;
     UsedUniqueStorage& operator=(const UsedUniqueStorage&) = delete;
@@ -126,8 +169,10 @@ public:
         if (!unique_.IsUnique(e))
             return;
 
-        used_.insert(e);
-        used_.insert(g_.conjugate(e));
+        SpeculationLog *log = this->log();
+        std::set<EdgeId> &used = log ? log->used_ : used_;
+        used.insert(e);
+        used.insert(g_.conjugate(e));
     }
 
 //    const ScaffoldingUniqueEdgeStorage& unique_edge_storage() const {
@@ -135,7 +180,15 @@ public:
 //    }
 
     bool IsUsedAndUnique(EdgeId e) const {
-        return (unique_.IsUnique(e) && used_.find(e) != used_.end());
+        if (!unique_.IsUnique(e))
+            return false;
+
+        if (SpeculationLog *log = this->log()) {
+            if (log->used_.count(e))
+                return true;
+            log->looked_up_.push_back(e);
+        }
+        return used_.find(e) != used_.end();
     }
 
     bool UniqueCheckEnabled() const {
@@ -154,6 +207,21 @@ public:
         return true;
     }
 
+    // Starts logging the changes made by the current thread instead of applying them
+    void StartSpeculation(SpeculationLog &log) const {
+        log.storage_ = this;
+        CurrentLog::set(&log);
+    }
+
+    void StopSpeculation() const {
+        VERIFY(log());
+        CurrentLog::set(nullptr);
+    }
+
+    // Applies the changes logged
+    void Commit(const SpeculationLog &log) {
+        used_.insert(log.used_.begin(), log.used_.end());
+    }
 };
 
 //FIXME rename
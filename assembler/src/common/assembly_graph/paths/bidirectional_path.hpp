@@ -16,10 +16,10 @@
 
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/components/connected_component.hpp"
+#include "utils/parallel/thread_local_ptr.hpp"
 #include <boost/algorithm/string.hpp>
 #include <algorithm>
 #include <atomic>
-#include <deque>
 #include <vector>
 
 using debruijn_graph::Graph;
@@ -102,38 +102,47 @@ public:
 
 class BidirectionalPath : public PathListener {
     static std::atomic<uint64_t> path_id_;
+    // Counter the ids of the paths created by the current thread are taken from, if set
+    typedef utils::ThreadLocalPtr<uint64_t, BidirectionalPath> IdSource;
+
+    static uint64_t NextId() {
+        uint64_t *source = IdSource::get();
+        return source ? (*source)++ : path_id_++;
+    }
 
     const Graph& g_;
-    std::deque<EdgeId> data_;
+    // The path is kept in the parallel arrays with spare room at both ends, so
+    // that the edges form a contiguous range and both ends grow in amortized O(1).
+    // Slots [first_, last_) are occupied.
+    std::vector<EdgeId> data_;
+    std::vector<Gap> gap_len_;  // e0 -> gap1 -> e1 -> ... -> gapN -> eN; gap0 = 0
+    // Position of the beginning of i-th edge counted from an arbitrary origin:
+    // pos_(i+1) = pos_i + L(e_i) + gap_(i+1), so the length from the beginning of
+    // i-th edge to path end L(e_i + gap_(i+1) + e_(i+1) + ... + gap_N + e_N) is
+    // pos_N + L(e_N) - pos_i and no lengths have to be updated on push / pop.
+    std::vector<long long> pos_;
+    size_t first_;
+    size_t last_;
     BidirectionalPath* conj_path_;
-    // Length from beginning of i-th edge to path end: L(e_i + gap_(i+1) + e_(i+1) + ... + gap_N + e_N)
-    std::deque<size_t> cumulative_len_;
-    std::deque<Gap> gap_len_;  // e0 -> gap1 -> e1 -> ... -> gapN -> eN; gap0 = 0
     std::vector<PathListener *> listeners_;
-    const uint64_t id_;  //Unique ID
+    uint64_t id_;  //Unique ID
     float weight_;
 
 public:
     BidirectionalPath(const Graph& g)
             : g_(g),
+              first_(0),
+              last_(0),
               conj_path_(nullptr),
-              id_(path_id_++),
+              id_(NextId()),
               weight_(1.0) {
     }
 
     BidirectionalPath(const Graph& g, const std::vector<EdgeId>& path)
             : BidirectionalPath(g) {
-        cumulative_len_.resize(path.size(), 0);
-        data_.resize(path.size());
-        gap_len_.resize(path.size(), Gap());
-
-        for (size_t i = 0; i < path.size(); ++i) {
-            data_[i] = path[i];
-            cumulative_len_.front() += g_.length(path[i]);
-        }
-        for (size_t i = 1; i < path.size(); ++i) {
-            cumulative_len_[i] = cumulative_len_[i - 1] - g_.length(data_[i - 1]);
-        }
+        Reallocate(0, path.size());
+        for (EdgeId e : path)
+            Append(e, Gap());
     }
 
     BidirectionalPath(const Graph& g, EdgeId e)
@@ -143,12 +152,14 @@ public:
 
     BidirectionalPath(const BidirectionalPath& path)
             : g_(path.g_),
-              data_(path.data_),
+              data_(path.data_.begin() + path.first_, path.data_.begin() + path.last_),
+              gap_len_(path.gap_len_.begin() + path.first_, path.gap_len_.begin() + path.last_),
+              pos_(path.pos_.begin() + path.first_, path.pos_.begin() + path.last_),
+              first_(0),
+              last_(path.Size()),
               conj_path_(nullptr),
-              cumulative_len_(path.cumulative_len_),
-              gap_len_(path.gap_len_),
               listeners_(),
-              id_(path_id_++),
+              id_(NextId()),
               weight_(path.weight_) {
     }
 
@@ -190,7 +201,7 @@ public:
     }
 
     size_t Size() const {
-        return data_.size();
+        return last_ - first_;
     }
 
     const Graph& graph() const {
@@ -198,24 +209,24 @@ public:
     }
 
     bool Empty() const {
-        return data_.empty();
+        return first_ == last_;
     }
 
     size_t Length() const {
         if (Empty()) {
             return 0;
         }
-        VERIFY(gap_len_[0].gap == 0);
-        return cumulative_len_[0];
+        VERIFY(gap_len_[first_].gap == 0);
+        return LengthAt(0);
     }
 
     //TODO iterators forward/reverse
     EdgeId operator[](size_t index) const {
-        return data_[index];
+        return data_[first_ + index];
     }
 
     EdgeId At(size_t index) const {
-        return data_[index];
+        return data_[first_ + index];
     }
 
     int ShiftLength(size_t index) const {
@@ -224,34 +235,52 @@ public:
 
     // Length from beginning of i-th edge to path end for forward directed path: L(e1 + e2 + ... + eN)
     size_t LengthAt(size_t index) const {
-        return cumulative_len_[index];
+        return size_t(EndPos() - pos_[first_ + index]);
     }
 
     Gap GapAt(size_t index) const {
-        return gap_len_[index];
+        return gap_len_[first_ + index];
     }
 
     void SetGapAt(size_t index, const Gap &gap) {
-        gap_len_[index] = gap;
+        long long shift = (long long) gap.gap - gap_len_[first_ + index].gap;
+        gap_len_[first_ + index] = gap;
+        for (size_t i = first_ + index; i < last_; ++i)
+            pos_[i] += shift;
     }
 
     size_t GetId() const {
         return id_;
     }
 
+    // Makes the paths created by the current thread take the ids from the given counter (or the global one if null)
+    static void SetIdSource(uint64_t *source) {
+        IdSource::set(source);
+    }
+
+    // Takes the given number of the consecutive ids from the global counter, returns the first one
+    static uint64_t ReserveIds(uint64_t count) {
+        return path_id_.fetch_add(count);
+    }
+
+    // Must not be called for the paths kept in the containers ordered by id
+    void SetId(uint64_t id) {
+        id_ = id;
+    }
+
     EdgeId Back() const {
-        return data_.back();
+        return data_[last_ - 1];
     }
 
     EdgeId Front() const {
-        return data_.front();
+        return data_[first_];
     }
 
     void PushBack(EdgeId e, const Gap& gap = Gap()) {
-        VERIFY(!data_.empty() || gap == Gap());
-        data_.push_back(e);
-        gap_len_.push_back(gap);
-        IncreaseLengths(g_.length(e), gap.gap);
+        VERIFY(!Empty() || gap == Gap());
+        if (last_ == data_.size())
+            Reallocate(0, std::max<size_t>(Size(), 4));
+        Append(e, gap);
         NotifyBackEdgeAdded(e, gap);
     }
 
@@ -266,13 +295,11 @@ public:
     }
 
     void PopBack() {
-        if (data_.empty()) {
+        if (Empty()) {
             return;
         }
-        EdgeId e = data_.back();
-        DecreaseLengths();
-        gap_len_.pop_back();
-        data_.pop_back();
+        EdgeId e = Back();
+        last_ -= 1;
         NotifyBackEdgeRemoved(e);
     }
 
@@ -304,17 +331,13 @@ public:
     }
 
     int FindFirst(EdgeId e) const {
-        for (size_t i = 0; i < Size(); ++i) {
-            if (data_[i] == e) {
-                return (int) i;
-            }
-        }
-        return -1;
+        auto it = std::find(begin(), end(), e);
+        return it == end() ? -1 : (int) (it - begin());
     }
 
     int FindLast(EdgeId e) const {
         for (int i = (int) Size() - 1; i >= 0; --i) {
-            if (data_[i] == e) {
+            if (At(i) == e) {
                 return i;
             }
         }
@@ -326,7 +349,7 @@ public:
     }
 
     bool Contains(VertexId v) const {
-        for(auto edge : data_) {
+        for(auto edge : *this) {
             if(g_.EdgeEnd(edge) == v || g_.EdgeStart(edge) == v ) {
                 return true;
             }
@@ -336,9 +359,9 @@ public:
 
     std::vector<size_t> FindAll(EdgeId e, size_t start = 0) const {
         std::vector<size_t> result;
-        for (size_t i = start; i < Size(); ++i) {
-            if (data_[i] == e) {
-                result.push_back(i);
+        for (auto it = begin() + std::min(start, Size()); it != end(); ++it) {
+            if (*it == e) {
+                result.push_back(it - begin());
             }
         }
         return result;
@@ -350,12 +373,7 @@ public:
             return false;
         }
 
-        for (size_t i = 0; i < sample.Size(); ++i) {
-            if (At(from + i) != sample[i]) {
-                return false;
-            }
-        }
-        return true;
+        return std::equal(sample.begin(), sample.end(), begin() + from);
     }
 
     size_t CommonEndSize(const BidirectionalPath& p) const {
@@ -417,7 +435,7 @@ public:
         VERIFY(from <= to && to <= Size());
         BidirectionalPath result(g_);
         for (size_t i = from; i < to; ++i) {
-            result.PushBack(data_[i], i == from ? Gap() : gap_len_[i]);
+            result.PushBack(At(i), i == from ? Gap() : GapAt(i));
         }
         return result;
     }
@@ -429,8 +447,8 @@ public:
     double Coverage() const {
         double cov = 0.0;
 
-        for (size_t i = 0; i < Size(); ++i) {
-            cov += g_.coverage(data_[i]) * (double) g_.length(data_[i]);
+        for (EdgeId e : *this) {
+            cov += g_.coverage(e) * (double) g_.length(e);
         }
         return cov / (double) Length();
     }
@@ -442,7 +460,7 @@ public:
         }
         result.PushBack(g_.conjugate(Back()));
         for (int i = ((int) Size()) - 2; i >= 0; --i) {
-            result.PushBack(g_.conjugate(data_[i]), gap_len_[i + 1].conjugate());
+            result.PushBack(g_.conjugate(At(i)), GapAt(i + 1).conjugate());
         }
 
         return result;
@@ -450,7 +468,7 @@ public:
 
     //FIXME remove
     std::vector<EdgeId> ToVector() const {
-        return std::vector<EdgeId>(data_.begin(), data_.end());
+        return std::vector<EdgeId>(begin(), end());
     }
 
     void PrintDEBUG() const {
@@ -487,12 +505,12 @@ public:
         return ss.str();
     }
 
-    auto begin() const -> decltype(data_.begin()) {
-        return data_.begin();
+    const EdgeId *begin() const {
+        return data_.data() + first_;
     }
 
-    auto end() const -> decltype(data_.end()) {
-        return data_.end();
+    const EdgeId *end() const {
+        return data_.data() + last_;
     }
 
 private:
@@ -504,20 +522,31 @@ private:
         return result;
     }
 
-    void IncreaseLengths(size_t length, int gap) {
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter += length + gap;
-        }
-        cumulative_len_.push_back(length);
+    long long EndPos() const {
+        return pos_[last_ - 1] + (long long) g_.length(data_[last_ - 1]);
     }
 
-    void DecreaseLengths() {
-        size_t length = g_.length(data_.back()) + gap_len_.back().gap;
+    // Moves the path to the new arrays with the given spare room added at the front and at the back
+    void Reallocate(size_t front_room, size_t back_room) {
+        size_t new_first = first_ + front_room;
+        size_t new_size = data_.size() + front_room + back_room;
+        auto move = [&](auto &v) {
+            typename std::decay<decltype(v)>::type moved(new_size);
+            std::copy(v.begin() + first_, v.begin() + last_, moved.begin() + new_first);
+            v.swap(moved);
+        };
+        move(data_);
+        move(gap_len_);
+        move(pos_);
+        last_ = new_first + Size();
+        first_ = new_first;
+    }
 
-        for (auto iter = cumulative_len_.begin(); iter != cumulative_len_.end(); ++iter) {
-            *iter -= length;
-        }
-        cumulative_len_.pop_back();
+    void Append(EdgeId e, const Gap& gap) {
+        pos_[last_] = Empty() ? 0 : EndPos() + gap.gap;
+        data_[last_] = e;
+        gap_len_[last_] = gap;
+        last_ += 1;
     }
 
     void NotifyFrontEdgeAdded(EdgeId e, Gap gap) {
@@ -545,29 +574,28 @@ private:
     }
 
     void PushFront(EdgeId e, Gap gap) {
-        data_.push_front(e);
-        if (gap_len_.size() > 0) {
-            VERIFY(gap_len_[0] == Gap());
-            gap_len_[0] = gap;
-        }
-        gap_len_.push_front(Gap());
+        if (first_ == 0)
+            Reallocate(std::max<size_t>(Size(), 4), 0);
 
-        int length = (int) g_.length(e);
-        if (cumulative_len_.empty()) {
-            cumulative_len_.push_front(length);
-        } else {
-            cumulative_len_.push_front(cumulative_len_.front() + length + gap.gap);
+        long long pos = 0;
+        if (!Empty()) {
+            VERIFY(gap_len_[first_] == Gap());
+            gap_len_[first_] = gap;
+            pos = pos_[first_] - gap.gap - (long long) g_.length(e);
         }
+        first_ -= 1;
+        data_[first_] = e;
+        gap_len_[first_] = Gap();
+        pos_[first_] = pos;
+
         NotifyFrontEdgeAdded(e, gap);
     }
 
     void PopFront() {
-        EdgeId e = data_.front();
-        data_.pop_front();
-        gap_len_.pop_front();
-        cumulative_len_.pop_front();
-        if (!gap_len_.empty()) {
-            gap_len_.front() = Gap();
+        EdgeId e = Front();
+        first_ += 1;
+        if (!Empty()) {
+            gap_len_[first_] = Gap();
         }
 
         NotifyFrontEdgeRemoved(e);
@@ -136,6 +136,12 @@ public:
         return true;
     }
 
+    // Moves all the pairs of the other container to the end of this one
+    void MoveAll(PathContainer &other) {
+        data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+        other.clear();
+    }
+
     void SortByLength(bool desc = true) {
         std::stable_sort(data_.begin(), data_.end(), [=](const PathPair& p1, const PathPair& p2) {
             if (p1.first->Empty() || p2.first->Empty() || p1.first->Length() != p2.first->Length()) {
@@ -8,6 +8,7 @@
 
 #include "io_base.hpp"
 #include "paired_info/paired_info.hpp"
+#include "paired_info/frozen_paired_index.hpp"
 
 namespace io {
 
@@ -26,6 +27,11 @@ struct IOTraits<omnigraph::de::PairedIndex<G, Traits, Container>> {
     typedef PairedIndexIO<omnigraph::de::PairedIndex<G, Traits, Container>> Type;
 };
 
+template<typename G, typename Traits>
+struct IOTraits<omnigraph::de::FrozenPairedIndex<G, Traits>> {
+    typedef PairedIndexIO<omnigraph::de::FrozenPairedIndex<G, Traits>> Type;
+};
+
 template<typename Index>
 class PairedIndicesIO : public IOCollection<omnigraph::de::PairedIndices<Index>> {
 public:
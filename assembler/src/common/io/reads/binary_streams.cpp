@@ -9,19 +9,77 @@
 #include "utils/verify.hpp"
 #include "utils/logger/logger.hpp"
 
-#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 
 namespace io {
 
-bool BinaryFileSingleStream::ReadImpl(SingleReadSeq &read) {
-    return read.BinRead(stream_);
+MappedBinaryFile::MappedBinaryFile(const std::string &file_name, size_t from, size_t to)
+        : region_(nullptr), region_size_(0), data_(nullptr), size_(0), file_size_(0) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd == -1)
+        FATAL_ERROR("open(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno << ". File: " << file_name);
+
+    struct stat buf;
+    if (fstat(fd, &buf) != 0)
+        FATAL_ERROR("fstat(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno << ". File: " << file_name);
+
+    file_size_ = buf.st_size;
+    to = std::min(to, file_size_);
+    if (from < to) {
+        // mmap(2) wants page-aligned offset
+        size_t page_size = (size_t)getpagesize();
+        size_t start = from / page_size * page_size;
+        region_size_ = to - start;
+        region_ = mmap(NULL, region_size_, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, start);
+        if (region_ == MAP_FAILED)
+            FATAL_ERROR("mmap(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno << ". File: " << file_name);
+        data_ = static_cast<const char*>(region_) + (from - start);
+        size_ = to - from;
+#ifdef MADV_HUGEPAGE
+        // Only has effect where huge pages for the page cache are supported
+        madvise(region_, region_size_, MADV_HUGEPAGE);
+#endif
+    }
+    close(fd);
+}
+
+MappedBinaryFile::~MappedBinaryFile() {
+    if (region_)
+        munmap(region_, region_size_);
+}
+
+void MappedBinaryFile::AdviseSequential(size_t from, size_t to) const {
+    to = std::min(to, size_);
+    if (!data_ || from >= to)
+        return;
+
+    // madvise(2) wants page-aligned start, the mapping itself is aligned
+    size_t page_size = (size_t)getpagesize();
+    size_t shift = size_t(data_ - static_cast<const char*>(region_));
+    size_t start = (shift + from) / page_size * page_size;
+    size_t len = shift + to - start;
+    void *addr = static_cast<char*>(region_) + start;
+    madvise(addr, len, MADV_SEQUENTIAL);
+    // Prefetch only the beginning, the rest is handled by the readahead
+    madvise(addr, std::min(len, size_t(64) << 20), MADV_WILLNEED);
+}
+
+const char *BinaryFileSingleStream::ReadImpl(const char *data, const char *end, SingleReadSeq &read) {
+    return read.BinRead(data, end);
 }
 
 BinaryFileSingleStream::BinaryFileSingleStream(const std::string &file_name_prefix, size_t portion_count, size_t portion_num)
         : BinaryFileStream(file_name_prefix, portion_count, portion_num) {}
 
-bool BinaryFilePairedStream::ReadImpl(PairedReadSeq& read) {
-    return read.BinRead(stream_, insert_size_);
+const char *BinaryFilePairedStream::ReadImpl(const char *data, const char *end, PairedReadSeq &read) {
+    return read.BinRead(data, end, insert_size_);
 }
 
 BinaryFilePairedStream::BinaryFilePairedStream(const std::string &file_name_prefix, size_t insert_size,
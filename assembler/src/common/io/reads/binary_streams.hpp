@@ -16,24 +16,55 @@
 #include "utils/logger/logger.hpp"
 #include "utils/filesystem/path_helper.hpp"
 
-#include <fstream>
+#include <memory>
+#include <cstring>
 
 namespace io {
 
+// Read-only mapping of the range [from, to) of a file (the whole file by default)
+class MappedBinaryFile {
+    void *region_;
+    size_t region_size_;
+    const char *data_;
+    size_t size_;
+    size_t file_size_;
+
+public:
+    MappedBinaryFile(const std::string &file_name,
+                     size_t from = 0, size_t to = size_t(-1));
+    ~MappedBinaryFile();
+
+    // Points to the file offset from
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t file_size() const { return file_size_; }
+
+    // Hints the kernel that the range [from, to) of the mapping is going to be read sequentially
+    void AdviseSequential(size_t from, size_t to) const;
+
+    MappedBinaryFile(const MappedBinaryFile&) = delete;
+    void operator=(const MappedBinaryFile&) = delete;
+};
+
 template<typename SeqT>
 class BinaryFileStream {
 protected:
-    std::ifstream stream_;
-
-    virtual bool ReadImpl(SeqT &read) = 0;
+    // Reads the record at [data, end), returns the pointer past it or
+    // nullptr if the record is truncated
+    virtual const char *ReadImpl(const char *data, const char *end, SeqT &read) = 0;
 
 private:
-    size_t offset_, count_, current_;
+    // Mapping of the current portion only
+    std::unique_ptr<MappedBinaryFile> file_;
+    size_t offset_, end_offset_, count_, current_;
+    const char *pos_, *end_;
 
     void Init() {
-        stream_.clear();
-        stream_.seekg(offset_);
-        VERIFY_MSG(stream_.good(), "Stream is not good(), offset_ " << offset_ << " count_ " << count_);
+        VERIFY_MSG(file_ && file_->size() == end_offset_ - offset_,
+                   "Stream is not good(), offset_ " << offset_ << " count_ " << count_);
+        file_->AdviseSequential(0, file_->size());
+        pos_ = file_->data();
+        end_ = pos_ + file_->size();
         current_ = 0;
     }
 
@@ -48,12 +79,19 @@ public:
         DEBUG("Preparing binary stream #" << portion_num << "/" << portion_count);
         VERIFY(portion_num < portion_count);
         const std::string fname = file_name_prefix + ".seq";
-        stream_.open(fname, std::ios_base::binary | std::ios_base::in);
+        size_t file_size = 0;
         ReadStreamStat stat;
-        stat.read(stream_);
+        {
+            MappedBinaryFile header(fname, 0, sizeof(ReadStreamStat));
+            VERIFY(header.size() == sizeof(ReadStreamStat));
+            memcpy(&stat, header.data(), sizeof(ReadStreamStat));
+            file_size = header.file_size();
+        }
 
         const std::string offset_name = file_name_prefix + ".off";
-        const size_t chunk_count = fs::filesize(offset_name) / sizeof(size_t);
+        MappedBinaryFile offsets(offset_name);
+        const size_t *chunk_offsets = reinterpret_cast<const size_t*>(offsets.data());
+        const size_t chunk_count = offsets.size() / sizeof(size_t);
 
         // We split all read chunks into portion_count portions
         // Portion could have size (chunk_count / portion_count) or (chunk_count / portion_count + 1)
@@ -73,25 +111,27 @@ public:
 
         if (chunk_num < chunk_count) {  // if we start from existing chunk
             // Calculating the absolute offset in the reads file
-            std::ifstream offset_stream(offset_name, std::ios_base::binary | std::ios_base::in);
-            offset_stream.seekg(chunk_num * sizeof(size_t));
-            offset_stream.read(reinterpret_cast<char *>(&offset_), sizeof(offset_));
+            offset_ = chunk_offsets[chunk_num];
             DEBUG("Offset read: " << offset_ << " chunk_count " << chunk_count << " chunk_num " << chunk_num << " portion_count " << portion_count << " portion_num " << portion_num << " prefix " << file_name_prefix << " name " << offset_name);
-            VERIFY(offset_stream);
             const bool is_big_portion = portion_num < big_portion_count;
+            const size_t portion_size = (is_big_portion ? big_portion_size : small_portion_size);
             const size_t start_num = chunk_num * BinaryWriter::CHUNK;
             // Last chunk could be incomplete => we should truncate count_ for last portions
-            count_ = std::min(stat.read_count - start_num,
-                              (is_big_portion ? big_portion_size : small_portion_size) * BinaryWriter::CHUNK);
+            count_ = std::min(stat.read_count - start_num, portion_size * BinaryWriter::CHUNK);
+            end_offset_ = (chunk_num + portion_size < chunk_count ?
+                           chunk_offsets[chunk_num + portion_size] : file_size);
 
             DEBUG("Reads " << start_num << "-" << start_num + count_ << "/" << stat.read_count << " from " << offset_);
         } else {  // current portion has size 0 (the case of chunk_count == 0 is also included here)
             // Setup safe offset value
-            offset_ = sizeof(ReadStreamStat);
+            offset_ = end_offset_ = sizeof(ReadStreamStat);
             count_ = 0;
             DEBUG("Empty BinaryFileStream constructed");
         }
 
+        VERIFY_MSG(offset_ <= end_offset_ && end_offset_ <= file_size,
+                   "Stream is not good(), offset_ " << offset_ << " end_offset_ " << end_offset_);
+        file_ = std::make_unique<MappedBinaryFile>(fname, offset_, end_offset_);
         Init();
     }
 
@@ -102,14 +142,15 @@ public:
             : BinaryFileStream(file_name_prefix, 1, 0) {}
 
     BinaryFileStream<SeqT>& operator>>(SeqT &read) {
-        ReadImpl(read);
         VERIFY(current_ < count_);
+        pos_ = ReadImpl(pos_, end_, read);
+        VERIFY_MSG(pos_, "Truncated read record in binary stream");
         ++current_;
         return *this;
     }
 
     bool is_open() {
-        return stream_.is_open();
+        return file_ != nullptr;
     }
 
     bool eof() {
@@ -118,7 +159,7 @@ public:
 
     void close() {
         current_ = 0;
-        stream_.close();
+        file_.reset();
     }
 
     void reset() {
@@ -129,7 +170,7 @@ public:
 
 class BinaryFileSingleStream : public BinaryFileStream<SingleReadSeq>  {
 protected:
-    bool ReadImpl(SingleReadSeq &read) override;
+    const char *ReadImpl(const char *data, const char *end, SingleReadSeq &read) override;
 public:
     BinaryFileSingleStream(const std::string &file_name_prefix, size_t portion_count, size_t portion_num);
 };
@@ -137,7 +178,7 @@ public:
 class BinaryFilePairedStream: public BinaryFileStream<PairedReadSeq> {
     size_t insert_size_;
 protected:
-    bool ReadImpl(PairedReadSeq& read) override;
+    const char *ReadImpl(const char *data, const char *end, PairedReadSeq &read) override;
 public:
     BinaryFilePairedStream(const std::string &file_name_prefix, size_t insert_size,
                            size_t portion_count, size_t portion_num);
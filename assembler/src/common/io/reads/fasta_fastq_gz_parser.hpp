@@ -13,10 +13,11 @@
 #include "io/reads/parser.hpp"
 #include "sequence/quality.hpp"
 #include "sequence/nucl.hpp"
+#include "parallel_gz_reader.hpp"
 
 #include "kseq/kseq.h"
 
-#include <zlib.h>
+#include <memory>
 #include <string>
 
 namespace io {
@@ -27,7 +28,7 @@ namespace fastafastqgz {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
 // STEP 1: declare the type of file handler and the read() function
-KSEQ_INIT(gzFile, gzread)
+KSEQ_INIT(ParallelGzReader*, gzread_parallel)
 #pragma GCC diagnostic pop
 }
 
@@ -95,7 +96,7 @@ public:
         // STEP 5: destroy seq
         fastafastqgz::kseq_destroy(seq_);
         // STEP 6: close the file handler
-        gzclose(fp_);
+        fp_.reset();
         is_open_ = false;
         eof_ = true;
     }
@@ -103,8 +104,9 @@ public:
 private:
     /*
      * @variable File that is associated with gzipped data file.
+     * Decompression is done in background.
      */
-    gzFile fp_;
+    std::unique_ptr<ParallelGzReader> fp_;
     /*
      * @variable Data element that stores last SingleRead got from
      * stream.
@@ -117,13 +119,14 @@ private:
     /* virtual */
     void open() {
         // STEP 2: open the file handler
-        fp_ = gzopen(filename_.c_str(), "r");
-        if (!fp_) {
+        fp_.reset(new ParallelGzReader(filename_));
+        if (!fp_->is_open()) {
+            fp_.reset();
             is_open_ = false;
             return;
         }
         // STEP 3: initialize seq
-        seq_ = fastafastqgz::kseq_init(fp_);
+        seq_ = fastafastqgz::kseq_init(fp_.get());
         eof_ = false;
         is_open_ = true;
         ReadAhead();
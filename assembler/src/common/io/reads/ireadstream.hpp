@@ -16,16 +16,18 @@
 #define IREADSTREAM_HPP_
 
 #include "kseq/kseq.h"
-#include <zlib.h>
+#include "parallel_gz_reader.hpp"
 #include "utils/verify.hpp"
 #include "read.hpp"
 #include "sequence/nucl.hpp"
 
+#include <memory>
+
 // Silence bogus gcc warnings
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
 // STEP 1: declare the type of file handler and the read() function
-KSEQ_INIT(gzFile, gzread)
+KSEQ_INIT(io::ParallelGzReader*, io::gzread_parallel)
 #pragma GCC diagnostic pop
 
 /*
@@ -107,7 +109,7 @@ ireadstream &operator>>(Read &r) {
 void close() {
     if (is_open()) {
         kseq_destroy(seq_); // STEP 5: destroy seq
-        gzclose(fp_); // STEP 6: close the file handler
+        fp_.reset(); // STEP 6: close the file handler
         is_open_ = false;
     }
 }
@@ -119,7 +121,7 @@ void reset() {
 
 private:
 std::string filename_;
-gzFile fp_;
+std::unique_ptr<io::ParallelGzReader> fp_;
 kseq_t *seq_;
 bool is_open_;
 bool eof_;
@@ -130,12 +132,13 @@ int offset_;
  * return true if it opened file, false otherwise
  */
 bool open(std::string filename) {
-    fp_ = gzopen(filename.c_str(), "r"); // STEP 2: open the file handler
-    if (!fp_) {
+    fp_.reset(new io::ParallelGzReader(filename)); // STEP 2: open the file handler
+    if (!fp_->is_open()) {
+        fp_.reset();
         return false;
     }
     is_open_ = true;
-    seq_ = kseq_init(fp_); // STEP 3: initialize seq
+    seq_ = kseq_init(fp_.get()); // STEP 3: initialize seq
     eof_ = false;
     read_ahead();
     return true;
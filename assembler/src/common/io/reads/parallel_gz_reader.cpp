@@ -0,0 +1,272 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "parallel_gz_reader.hpp"
+
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include "threadpool/threadpool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+namespace io {
+
+static const size_t CHUNK_SIZE = 1 << 20;
+static const size_t BGZF_HEADER_SIZE = 18;
+
+// Decompression tasks never wait for anything, so the pool is shared by all
+// the readers of the process.
+static size_t DecompressionThreads() {
+    static size_t nthreads = std::max(omp_get_max_threads(), 1);
+    return nthreads;
+}
+
+static ThreadPool::ThreadPool &DecompressionPool() {
+    static ThreadPool::ThreadPool pool(DecompressionThreads());
+    return pool;
+}
+
+static bool IsBGZFHeader(const unsigned char *hdr) {
+    return hdr[0] == 31 && hdr[1] == 139 && hdr[2] == 8 && (hdr[3] & 4) &&
+           hdr[10] == 6 && hdr[11] == 0 &&
+           hdr[12] == 'B' && hdr[13] == 'C' && hdr[14] == 2 && hdr[15] == 0;
+}
+
+ParallelGzReader::ParallelGzReader(const std::string &filename)
+        : filename_(filename), file_(nullptr), format_(Format::Plain),
+          input_eof_(false), max_pending_(1), pos_(0),
+          strm_(), in_(CHUNK_SIZE), in_pos_(0), in_end_(0), member_start_(true) {
+    file_ = fopen(filename.c_str(), "rb");
+    if (!file_)
+        return;
+
+    // Peek the header of the first member, it will be consumed by the first read
+    in_end_ = fread(in_.data(), 1, BGZF_HEADER_SIZE, file_);
+    if (in_end_ >= 2 && in_[0] == 31 && in_[1] == 139) {
+        if (in_end_ == BGZF_HEADER_SIZE && IsBGZFHeader(in_.data())) {
+            format_ = Format::BGZF;
+            max_pending_ = 2 * DecompressionThreads();
+        } else {
+            format_ = Format::Gzip;
+            if (inflateInit2(&strm_, 15 + 16) != Z_OK)
+                FATAL_ERROR("Failed to initialize decompression of " << filename_);
+        }
+    }
+}
+
+ParallelGzReader::~ParallelGzReader() {
+    // Tasks might refer to the reader state
+    for (auto &task : pending_)
+        task.wait();
+
+    if (format_ == Format::Gzip)
+        inflateEnd(&strm_);
+    if (file_)
+        fclose(file_);
+}
+
+int ParallelGzReader::read(void *buf, unsigned len) {
+    char *out = static_cast<char*>(buf);
+    size_t done = 0;
+    while (done < len) {
+        if (pos_ == current_.size() && !Refill())
+            break;
+
+        size_t n = std::min(size_t(len) - done, current_.size() - pos_);
+        memcpy(out + done, current_.data() + pos_, n);
+        pos_ += n;
+        done += n;
+    }
+
+    return int(done);
+}
+
+size_t ParallelGzReader::ReadRaw(unsigned char *dst, size_t len) {
+    size_t done = 0;
+    if (in_pos_ < in_end_) {
+        done = std::min(len, in_end_ - in_pos_);
+        memmove(dst, in_.data() + in_pos_, done);
+        in_pos_ += done;
+    }
+    if (done < len)
+        done += fread(dst + done, 1, len - done, file_);
+    if (done < len && ferror(file_))
+        throw std::runtime_error(std::string("I/O error, ") + strerror(errno));
+
+    return done;
+}
+
+void ParallelGzReader::Submit() {
+    auto &pool = DecompressionPool();
+    while (!input_eof_ && pending_.size() < max_pending_) {
+        switch (format_) {
+            case Format::BGZF: {
+                std::vector<Chunk> blocks;
+                try {
+                    blocks = ReadBGZFBlocks();
+                } catch (std::exception &e) {
+                    FATAL_ERROR("Cannot read " << filename_ << ": " << e.what());
+                }
+                if (blocks.empty())
+                    break;
+                pending_.push_back(pool.run([this, blocks = std::move(blocks)] { return InflateBGZF(blocks); }));
+                break;
+            }
+            // Sequential formats always have at most one task in flight
+            case Format::Gzip:
+                pending_.push_back(pool.run([this] { return InflateGzip(); }));
+                return;
+            case Format::Plain:
+                pending_.push_back(pool.run([this] { return ReadPlain(); }));
+                return;
+        }
+    }
+}
+
+bool ParallelGzReader::Refill() {
+    while (true) {
+        Submit();
+        if (pending_.empty())
+            return false;
+
+        try {
+            current_ = pending_.front().get();
+        } catch (std::exception &e) {
+            FATAL_ERROR("Cannot read " << filename_ << ": " << e.what());
+        }
+        pending_.pop_front();
+        pos_ = 0;
+
+        // Start the next chunk while this one is being parsed
+        Submit();
+        if (!current_.empty())
+            return true;
+    }
+}
+
+ParallelGzReader::Chunk ParallelGzReader::ReadPlain() {
+    Chunk out(CHUNK_SIZE);
+    size_t n = ReadRaw(reinterpret_cast<unsigned char*>(out.data()), out.size());
+    if (n < out.size())
+        input_eof_ = true;
+    out.resize(n);
+
+    return out;
+}
+
+ParallelGzReader::Chunk ParallelGzReader::InflateGzip() {
+    Chunk out(CHUNK_SIZE);
+    size_t have = 0;
+    while (have < out.size() && !input_eof_) {
+        if (strm_.avail_in == 0) {
+            size_t n = ReadRaw(in_.data(), in_.size());
+            if (n == 0) {
+                if (!member_start_)
+                    WARN("Unexpected end of file " << filename_);
+                input_eof_ = true;
+                break;
+            }
+            strm_.next_in = in_.data();
+            strm_.avail_in = unsigned(n);
+        }
+
+        strm_.next_out = reinterpret_cast<Bytef*>(out.data() + have);
+        strm_.avail_out = unsigned(out.size() - have);
+        int ret = inflate(&strm_, Z_NO_FLUSH);
+        have = out.size() - strm_.avail_out;
+        if (ret == Z_STREAM_END) {
+            // Multi-member file, continue with the next member (if any)
+            inflateReset(&strm_);
+            member_start_ = true;
+            continue;
+        }
+
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            // Trailing garbage after the last member is ignored, as gzread does
+            if (member_start_ && ret == Z_DATA_ERROR) {
+                input_eof_ = true;
+                break;
+            }
+            throw std::runtime_error(std::string("decompression failed, ") + (strm_.msg ? strm_.msg : "unknown error"));
+        }
+        member_start_ = false;
+    }
+    out.resize(have);
+
+    return out;
+}
+
+std::vector<ParallelGzReader::Chunk> ParallelGzReader::ReadBGZFBlocks() {
+    std::vector<Chunk> blocks;
+    size_t total = 0;
+    while (total < CHUNK_SIZE) {
+        unsigned char hdr[BGZF_HEADER_SIZE];
+        size_t n = ReadRaw(hdr, BGZF_HEADER_SIZE);
+        if (n == 0) {
+            input_eof_ = true;
+            break;
+        }
+        if (n < BGZF_HEADER_SIZE || !IsBGZFHeader(hdr))
+            throw std::runtime_error("corrupted BGZF block");
+
+        size_t bsize = size_t(hdr[16] | (hdr[17] << 8)) + 1;
+        if (bsize < BGZF_HEADER_SIZE + 8)
+            throw std::runtime_error("corrupted BGZF block");
+
+        Chunk block(bsize);
+        memcpy(block.data(), hdr, BGZF_HEADER_SIZE);
+        unsigned char *rest = reinterpret_cast<unsigned char*>(block.data()) + BGZF_HEADER_SIZE;
+        if (ReadRaw(rest, bsize - BGZF_HEADER_SIZE) != bsize - BGZF_HEADER_SIZE)
+            throw std::runtime_error("truncated BGZF block");
+
+        const unsigned char *isize = reinterpret_cast<const unsigned char*>(block.data()) + bsize - 4;
+        total += size_t(isize[0]) | size_t(isize[1]) << 8 | size_t(isize[2]) << 16 | size_t(isize[3]) << 24;
+        blocks.push_back(std::move(block));
+    }
+
+    return blocks;
+}
+
+ParallelGzReader::Chunk ParallelGzReader::InflateBGZF(const std::vector<Chunk> &blocks) const {
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    for (const auto &block : blocks) {
+        const unsigned char *isize = reinterpret_cast<const unsigned char*>(block.data()) + block.size() - 4;
+        sizes.push_back(size_t(isize[0]) | size_t(isize[1]) << 8 | size_t(isize[2]) << 16 | size_t(isize[3]) << 24);
+        total += sizes.back();
+    }
+
+    // One extra byte so the output buffer is never empty (e.g. for EOF block)
+    Chunk out(total + 1);
+    size_t have = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        z_stream strm = {};
+        if (inflateInit2(&strm, 15 + 16) != Z_OK)
+            throw std::runtime_error("failed to initialize decompression");
+
+        strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(blocks[i].data()));
+        strm.avail_in = unsigned(blocks[i].size());
+        strm.next_out = reinterpret_cast<Bytef*>(out.data() + have);
+        strm.avail_out = unsigned(out.size() - have);
+        int ret = inflate(&strm, Z_FINISH);
+        size_t produced = strm.total_out;
+        inflateEnd(&strm);
+        if (ret != Z_STREAM_END || produced != sizes[i])
+            throw std::runtime_error("corrupted BGZF block");
+
+        have += produced;
+    }
+    out.resize(have);
+
+    return out;
+}
+
+}
@@ -0,0 +1,82 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <zlib.h>
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace io {
+
+/*
+ * Drop-in replacement of gzFile / gzread for the sequence parsers which moves
+ * the decompression off the parsing thread.
+ *
+ * BGZF files (and any other gzip files made of independent members carrying
+ * the BGZF block size in the header) are inflated block-wise in parallel on
+ * the shared decompression pool. Other gzip files (including multi-member
+ * ones without the block sizes) are inflated sequentially, but in background:
+ * the next chunk is inflated while the current one is being parsed. Plain
+ * files are read in the same double-buffered manner.
+ */
+class ParallelGzReader {
+    typedef std::vector<char> Chunk;
+
+  public:
+    ParallelGzReader(const std::string &filename);
+    ~ParallelGzReader();
+
+    bool is_open() const { return file_ != nullptr; }
+    bool is_bgzf() const { return format_ == Format::BGZF; }
+
+    // Reads up to len bytes, returns the number of bytes read (0 on EOF)
+    int read(void *buf, unsigned len);
+
+  private:
+    enum class Format { Plain, Gzip, BGZF };
+
+    std::string filename_;
+    FILE *file_;
+    Format format_;
+    // Set by the background tasks, checked by the parsing thread
+    std::atomic<bool> input_eof_;
+    size_t max_pending_;
+    std::deque<std::future<Chunk>> pending_;
+    Chunk current_;
+    size_t pos_;
+
+    // State of the sequential inflate. Only a single task could use it at a time.
+    z_stream strm_;
+    // Input buffer, initially holds the peeked header
+    std::vector<unsigned char> in_;
+    size_t in_pos_, in_end_;
+    std::atomic<bool> member_start_;
+
+    size_t ReadRaw(unsigned char *dst, size_t len);
+    void Submit();
+    bool Refill();
+    Chunk ReadPlain();
+    Chunk InflateGzip();
+    std::vector<Chunk> ReadBGZFBlocks();
+    Chunk InflateBGZF(const std::vector<Chunk> &blocks) const;
+
+    ParallelGzReader(const ParallelGzReader&) = delete;
+    void operator=(const ParallelGzReader&) = delete;
+};
+
+// kseq-compatible read function
+inline int gzread_parallel(ParallelGzReader *reader, void *buf, unsigned len) {
+    return reader->read(buf, len);
+}
+
+}
@@ -8,22 +8,50 @@
 #ifndef __HAMMER_READ_PROCESSOR_HPP__
 #define __HAMMER_READ_PROCESSOR_HPP__
 
-#include "io/reads/mpmc_bounded.hpp"
 #include "utils/parallel/openmp_wrapper.h"
+#include "utils/verify.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <map>
 #include <memory>
-#include <sched.h>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma clang diagnostic ignored "-Wunused-private-field"
 #endif
 namespace hammer {
+
+// Runs the processor over all the reads of the stream in parallel. Reads are
+// parsed in batches of batch_size reads: every thread owns a batch which is
+// reused from one fill to another, takes the reader for the time needed to
+// fill it and then processes the whole batch on its own. The processor might
+// accept either const ReadT& (preferred, the read stays in the batch) or
+// std::unique_ptr<ReadT> (the read is moved into the fresh heap object).
 class ReadProcessor {
     static size_t constexpr cacheline_size = 64;
     typedef char cacheline_pad_t[cacheline_size];
 
+    // Reads taken from the stream, but left unprocessed due to the stop request
+    struct PendingReads {
+        virtual ~PendingReads() {}
+        virtual size_t size() const = 0;
+    };
+
+    template<class ReadT>
+    struct PendingReadsOf : public PendingReads {
+        std::vector<ReadT> reads;
+        size_t size() const override { return reads.size(); }
+    };
+
     unsigned nthreads_;
+    size_t batch_size_;
+    std::unique_ptr<PendingReads> pending_;
     cacheline_pad_t pad0;
     size_t read_;
     cacheline_pad_t pad1;
@@ -31,17 +59,66 @@ class ReadProcessor {
     cacheline_pad_t pad2;
 
 private:
+    template<class Op, class ReadT>
+    static auto Process(Op &op, ReadT &r, int) -> decltype(op(static_cast<const ReadT&>(r))) {
+        return op(static_cast<const ReadT&>(r));
+    }
+
+    template<class Op, class ReadT>
+    static auto Process(Op &op, ReadT &r, long) -> decltype(op(std::unique_ptr<ReadT>())) {
+        return op(std::unique_ptr<ReadT>(new ReadT(std::move(r)))); // Pass ownership of read down to processor
+    }
+
+    template<class Reader>
+    static size_t ReadBatch(Reader &irs, std::vector<typename Reader::ReadT> &batch,
+                            std::vector<typename Reader::ReadT> *pending = nullptr) {
+        size_t n = 0;
+        while (n < batch.size() && pending && !pending->empty()) {
+            batch[n++] = std::move(pending->back());
+            pending->pop_back();
+        }
+        while (n < batch.size() && !irs.eof())
+            irs >> batch[n++];
+
+        return n;
+    }
+
+    template<class ReadT>
+    std::vector<ReadT> TakePending() {
+        std::vector<ReadT> res;
+        if (!pending_)
+            return res;
+
+        auto *pending = dynamic_cast<PendingReadsOf<ReadT>*>(pending_.get());
+        VERIFY_MSG(pending, "Pending reads were left by a run over the stream of another type");
+        res = std::move(pending->reads);
+        pending_.reset();
+        return res;
+    }
+
     template<class Reader, class Op>
     bool RunSingle(Reader &irs, Op &op) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        typename Reader::ReadT r;
+
+        auto pending = TakePending<typename Reader::ReadT>();
+        while (!pending.empty()) {
+            r = std::move(pending.back());
+            pending.pop_back();
+            read_ += 1;
+
+            processed_ += 1;
+            if (Process(op, r, 0)) {
+                SetPending(std::move(pending));
+                return true;
+            }
+        }
 
         while (!irs.eof()) {
-            ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-            irs >> *r;
+            irs >> r;
             read_ += 1;
 
             processed_ += 1;
-            if (op(std::move(r))) // Pass ownership of read down to processor
+            if (Process(op, r, 0))
                 return true;
         }
 
@@ -50,14 +127,13 @@ private:
 
     template<class Reader, class Op, class Writer>
     void RunSingle(Reader &irs, Op &op, Writer &writer) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        typename Reader::ReadT r;
 
         while (!irs.eof()) {
-            ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-            irs >> *r;
+            irs >> r;
             read_ += 1;
 
-            auto res = op(std::move(r)); // Pass ownership of read down to processor
+            auto res = Process(op, r, 0);
             processed_ += 1;
 
             if (res)
@@ -65,142 +141,146 @@ private:
         }
     }
 
+    template<class ReadT>
+    void SetPending(std::vector<ReadT> reads) {
+        if (reads.empty())
+            return;
+
+        std::unique_ptr<PendingReadsOf<ReadT>> pending(new PendingReadsOf<ReadT>());
+        pending->reads = std::move(reads);
+        pending_ = std::move(pending);
+    }
+
 public:
-    ReadProcessor(unsigned nthreads)
-            : nthreads_(nthreads), read_(0), processed_(0) { }
+    ReadProcessor(unsigned nthreads, size_t batch_size = 1024)
+            : nthreads_(nthreads), batch_size_(batch_size), read_(0), processed_(0) { }
 
+    // Number of reads given to the processor; the pending reads are not counted
     size_t read() const { return read_; }
 
     size_t processed() const { return processed_; }
 
+    // True if some reads were taken from the stream, but not processed due to
+    // the stop request. The subsequent Run processes them first.
+    bool pending() const { return pending_ && pending_->size(); }
+
+    // Returns true if the processor requested to stop. Every thread checks
+    // the request before each read, the reads left unprocessed are kept as
+    // pending, so the stream could be continued by the subsequent Run.
     template<class Reader, class Op>
     bool Run(Reader &irs, Op &op) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        using ReadT = typename Reader::ReadT;
 
         if (nthreads_ < 2)
             return RunSingle(irs, op);
 
-        // Round nthreads to next power of two
-        unsigned bufsize = nthreads_ - 1;
-        bufsize = (bufsize >> 1) | bufsize;
-        bufsize = (bufsize >> 2) | bufsize;
-        bufsize = (bufsize >> 4) | bufsize;
-        bufsize = (bufsize >> 8) | bufsize;
-        bufsize = (bufsize >> 16) | bufsize;
-        bufsize += 1;
-
-        mpmc_bounded_queue<ReadPtr> in_queue(2 * bufsize);
-
-        bool stop = false;
-#   pragma omp parallel shared(in_queue, irs, op, stop) num_threads(nthreads_)
+        std::vector<ReadT> pending = TakePending<ReadT>();
+        std::mutex reader_lock;
+        std::atomic<bool> stop(false);
+#   pragma omp parallel shared(irs, op, stop, reader_lock, pending) num_threads(nthreads_)
         {
-#     pragma omp master
-            {
-                while (!irs.eof()) {
-                    ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-                    irs >> *r;
-#         pragma omp atomic
-                    read_ += 1;
-
-                    while (!in_queue.enqueue(std::move(r)))
-                        sched_yield();
-
-#         pragma omp flush (stop)
-                    if (stop)
-                        break;
+            std::vector<ReadT> batch(batch_size_);
+
+            while (true) {
+                size_t n = 0;
+                {
+                    std::lock_guard<std::mutex> guard(reader_lock);
+                    if (!stop)
+                        n = ReadBatch(irs, batch, &pending);
                 }
-
-                in_queue.close();
-            }
-
-            while (1) {
-                ReadPtr r;
-
-                if (!in_queue.wait_dequeue(r))
+                if (!n)
                     break;
 
+                size_t i = 0;
+                for (; i < n && !stop; ++i) {
+                    if (Process(op, batch[i], 0))
+                        stop = true;
+                }
+
+#       pragma omp atomic
+                read_ += i;
 #       pragma omp atomic
-                processed_ += 1;
+                processed_ += i;
 
-                bool res = op(std::move(r));
-                if (res) {
-#         pragma omp atomic
-                    stop |= res;
+                if (i < n) {
+                    std::lock_guard<std::mutex> guard(reader_lock);
+                    std::move(batch.begin() + i, batch.begin() + n, std::back_inserter(pending));
                 }
             }
         }
 
-#   pragma omp flush(stop)
+        SetPending(std::move(pending));
         return stop;
     }
 
+    // Same as above, but the results of the processor are written in the
+    // order of the input reads. Batches are processed independently, the
+    // finished ones are kept until all the preceding batches are written.
+    // At most 2 * nthreads batches are in flight, the parsers wait for the
+    // writes to catch up otherwise.
     template<class Reader, class Op, class Writer>
     void Run(Reader &irs, Op &op, Writer &writer) {
-        using ReadPtr = std::unique_ptr<typename Reader::ReadT>;
+        using ReadT = typename Reader::ReadT;
+        using ResultPtr = decltype(Process(op, std::declval<ReadT&>(), 0));
 
         if (nthreads_ < 2) {
             RunSingle(irs, op, writer);
             return;
         }
 
-        // Round nthreads to next power of two
-        unsigned bufsize = nthreads_ - 1;
-        bufsize = (bufsize >> 1) | bufsize;
-        bufsize = (bufsize >> 2) | bufsize;
-        bufsize = (bufsize >> 4) | bufsize;
-        bufsize = (bufsize >> 8) | bufsize;
-        bufsize = (bufsize >> 16) | bufsize;
-        bufsize += 1;
-
-        mpmc_bounded_queue<ReadPtr> in_queue(bufsize), out_queue(2 * bufsize);
-#   pragma omp parallel shared(in_queue, out_queue, irs, op, writer) num_threads(nthreads_)
+        std::mutex reader_lock, writer_lock;
+        std::condition_variable written;
+        size_t next_batch = 0, next_write = 0;
+        const size_t max_batches = 2 * nthreads_;
+        std::map<size_t, std::vector<ResultPtr>> pending;
+#   pragma omp parallel shared(irs, op, writer, reader_lock, writer_lock, written, next_batch, next_write, pending) num_threads(nthreads_)
         {
-#     pragma omp master
-            {
-                while (!irs.eof()) {
-                    ReadPtr r = ReadPtr(new typename Reader::ReadT) ;
-                    irs >> *r;
-
-                    // First, try to provide read to the queue. If it's full, never mind.
-                    bool status = in_queue.enqueue(std::move(r));
-
-                    // Flush down the output queue
-                    ReadPtr outr;
-                    while (out_queue.dequeue(outr))
-                        writer << *outr;
-
-                    // If the input queue was originally full, wait until we can insert
-                    // the read once again.
-                    if (!status)
-                        while (!in_queue.enqueue(std::move(r)))
-                            sched_yield();
+            std::vector<ReadT> batch(batch_size_);
+
+            while (true) {
+                size_t n = 0, id = 0;
+                {
+                    std::lock_guard<std::mutex> guard(reader_lock);
+                    {
+                        // The batch next_write is owned by a thread that does
+                        // not wait here, so the writes always make progress
+                        std::unique_lock<std::mutex> wguard(writer_lock);
+                        written.wait(wguard, [&] { return next_batch < next_write + max_batches; });
+                    }
+                    n = ReadBatch(irs, batch);
+                    id = next_batch++;
                 }
+                if (!n)
+                    break;
 
-                in_queue.close();
-
-                // Flush down the output queue while in master threads.
-                ReadPtr outr;
-                while (out_queue.dequeue(outr))
-                    writer << *outr;
-            }
-
-            while (1) {
-                ReadPtr r;
+#       pragma omp atomic
+                read_ += n;
 
-                if (!in_queue.wait_dequeue(r))
-                    break;
+                std::vector<ResultPtr> results;
+                results.reserve(n);
+                for (size_t i = 0; i < n; ++i)
+                    results.push_back(Process(op, batch[i], 0));
 
-                auto res = op(std::move(r));
-                if (res)
-                    while (!out_queue.enqueue(std::move(res)))
-                        sched_yield();
+#       pragma omp atomic
+                processed_ += n;
+
+                std::lock_guard<std::mutex> guard(writer_lock);
+                pending.emplace(id, std::move(results));
+                // Flush down all the batches that are ready to be written
+                size_t prev_write = next_write;
+                for (auto it = pending.begin();
+                     it != pending.end() && it->first == next_write;
+                     it = pending.erase(it), ++next_write) {
+                    for (const auto &res : it->second)
+                        if (res)
+                            writer << *res;
+                }
+                if (next_write != prev_write)
+                    written.notify_all();
             }
         }
 
-        // Flush down the output queue
-        ReadPtr outr;
-        while (out_queue.dequeue(outr))
-            writer << *outr;
+        VERIFY(pending.empty());
     }
 };
 
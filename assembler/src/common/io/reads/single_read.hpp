@@ -15,6 +15,7 @@
 #include "utils/stl_utils.hpp"
 
 #include <string>
+#include <cstring>
 
 namespace io {
 
@@ -266,6 +267,17 @@ public:
         return !file.fail();
     }
 
+    const char *BinRead(const char *data, const char *end) {
+        data = seq_.BinRead(data, end);
+        if (!data || size_t(end - data) < sizeof(left_offset_) + sizeof(right_offset_))
+            return nullptr;
+        memcpy(&left_offset_, data, sizeof(left_offset_));
+        data += sizeof(left_offset_);
+        memcpy(&right_offset_, data, sizeof(right_offset_));
+        data += sizeof(right_offset_);
+        return data;
+    }
+
     bool BinWrite(std::ostream &file, bool rc = false) const {
         if (rc)
             (!seq_).BinWrite(file);
@@ -86,6 +86,31 @@ public:
         }
     }
 
+    // Same as get() for every k-mer of the batch. The lookups are done stage by
+    // stage over the whole batch, so the random memory accesses of different
+    // k-mers overlap instead of being waited for one by one.
+    void get(const KMer *kmers, size_t count, std::pair<EdgeId, size_t> *res) const {
+        VERIFY(this->IsAttached());
+        // Key with hash refers to the index, so it could not be kept in a
+        // fixed array; the buffer is reused by all the calls of the thread
+        static thread_local std::vector<typename InnerIndex::KeyWithHash> kwhs;
+        kwhs.clear();
+        for (size_t i = 0; i < count; ++i) {
+            kwhs.push_back(inner_index_.ConstructKWH(kmers[i]));
+            if (inner_index_.valid(kwhs.back()))
+                __builtin_prefetch(&inner_index_.get_raw_value_reference(kwhs.back()));
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            if (!inner_index_.contains(kwhs[i])) {
+                res[i] = { EdgeId(), -1u };
+            } else {
+                EdgeInfo<EdgeId> entry = inner_index_.get_value(kwhs[i]);
+                res[i] = { entry.edge(), (size_t)entry.offset() };
+            }
+        }
+    }
+
     void Refill() {
         clear();
         refiller_.Refill(inner_index_, this->g());
@@ -8,133 +8,211 @@
 #define __KMER_MAP_HPP__
 
 #include "sequence/rtseq.hpp"
+#include "utils/verify.hpp"
 
-#include <tsl/htrie_map.h>
 #include <boost/iterator/iterator_facade.hpp>
 
+#include <cstring>
+#include <vector>
+
 namespace debruijn_graph {
-class KMerMap {
-    struct str_hash {
-        std::size_t operator()(const char* key, std::size_t key_size) const {
-            return CityHash64(key, key_size);
-        }
-    };
 
+// Open-addressing k-mer -> k-mer map. Keys and values are stored inline,
+// side by side in a single flat array, slots are probed linearly.
+// Pointers returned by find() stay valid until the next insertion.
+class KMerMap {
     typedef RtSeq Kmer;
     typedef RtSeq Seq;
     typedef typename Seq::DataType RawSeqData;
-    typedef typename tsl::htrie_map<char, RawSeqData*, str_hash> HTMap;
+
+    enum SlotState : uint8_t { Empty = 0, Full, Deleted };
 
     class iterator : public boost::iterator_facade<iterator,
                                                    const std::pair<Kmer, Seq>,
                                                    std::forward_iterator_tag,
                                                    const std::pair<Kmer, Seq>> {
       public:
-        iterator(unsigned k, HTMap::const_iterator iter)
-                : k_(k), iter_(iter) {}
+        iterator(const KMerMap &map, size_t slot)
+                : map_(&map), slot_(slot) {
+            skip();
+        }
 
       private:
         friend class boost::iterator_core_access;
 
+        void skip() {
+            while (slot_ < map_->capacity() && map_->state_[slot_] != Full)
+                ++slot_;
+        }
+
         void increment() {
-            ++iter_;
+            ++slot_;
+            skip();
         }
 
         bool equal(const iterator &other) const {
-            return iter_ == other.iter_;
+            return slot_ == other.slot_;
         }
 
         const std::pair<Kmer, Seq> dereference() const {
-            iter_.key(key_out_);
-            Kmer k(k_, (const RawSeqData*)key_out_.data());
-            Seq s(k_, (const RawSeqData*)iter_.value());
-            return std::make_pair(k, s);
+            return std::make_pair(Kmer(map_->k_, map_->key_at(slot_)),
+                                  Seq(map_->k_, map_->value_at(slot_)));
         }
 
-        unsigned k_;
-        HTMap::const_iterator iter_;
-        mutable std::string key_out_;
+        const KMerMap *map_;
+        size_t slot_;
     };
 
   public:
     KMerMap(unsigned k)
-            : k_(k) {
+            : k_(k), size_(0), deleted_(0) {
         rawcnt_ = (unsigned)Seq::GetDataSize(k_);
     }
 
-    ~KMerMap() {
-        clear();
-    }
-
     void erase(const Kmer &key) {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
+        size_t slot = find_slot(key.data());
+        if (slot == -1ULL)
             return;
 
-        delete[] res.value();
-        mapping_.erase(res);
+        state_[slot] = Deleted;
+        size_ -= 1;
+        deleted_ += 1;
     }
 
     void set(const Kmer &key, const Seq &value) {
-        RawSeqData *rawvalue = nullptr;
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end()) {
-            rawvalue = new RawSeqData[rawcnt_];
-            mapping_.insert_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData), rawvalue);
-        } else {
-            rawvalue = res.value();
+        size_t slot = find_slot(key.data());
+        if (slot == -1ULL) {
+            if ((size_ + deleted_ + 1) * 4 > capacity() * 3)
+                rehash(2 * (size_ + 1));
+            slot = insert_slot(key.data());
+            memcpy(key_at(slot), key.data(), rawcnt_ * sizeof(RawSeqData));
         }
-        memcpy(rawvalue, value.data(), rawcnt_ * sizeof(RawSeqData));
+        memcpy(value_at(slot), value.data(), rawcnt_ * sizeof(RawSeqData));
     }
 
     bool count(const Kmer &key) const {
-        return mapping_.count_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
+        return find_slot(key.data()) != -1ULL;
     }
 
     const RawSeqData *find(const Kmer &key) const {
-        auto res = mapping_.find_ks((const char*)key.data(), rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
-            return nullptr;
-
-        return res.value();
+        return find(key.data());
     }
 
     const RawSeqData *find(const RawSeqData *key) const {
-        auto res = mapping_.find_ks((const char*)key, rawcnt_ * sizeof(RawSeqData));
-        if (res == mapping_.end())
+        size_t slot = find_slot(key);
+        if (slot == -1ULL)
             return nullptr;
 
-        return res.value();
+        return value_at(slot);
     }
 
-    void clear() {
-        // Delete all the values
-        for (auto it = mapping_.begin(); it != mapping_.end(); ++it) {
-            VERIFY(it.value() != nullptr);
-            delete[] it.value();
-            it.value() = nullptr;
-        }
+    // Makes room for the given number of entries without rehashing
+    void reserve(size_t size) {
+        if ((size + deleted_) * 4 > capacity() * 3)
+            rehash(size);
+    }
 
-        // Delete the mapping and all the keys
-        mapping_.clear();
+    void clear() {
+        std::vector<RawSeqData>().swap(data_);
+        std::vector<uint8_t>().swap(state_);
+        size_ = deleted_ = 0;
     }
 
     size_t size() const {
-        return mapping_.size();
+        return size_;
     }
 
     iterator begin() const {
-        return iterator(k_, mapping_.begin());
+        return iterator(*this, 0);
     }
 
     iterator end() const {
-        return iterator(k_, mapping_.end());
+        return iterator(*this, capacity());
     }
 
   private:
     unsigned k_;
     unsigned rawcnt_;
-    HTMap mapping_;
+    size_t size_;
+    size_t deleted_;
+    // Slot i holds the key at 2 * i * rawcnt_ and the value right after it
+    std::vector<RawSeqData> data_;
+    std::vector<uint8_t> state_;
+
+    size_t capacity() const {
+        return state_.size();
+    }
+
+    RawSeqData *key_at(size_t slot) {
+        return data_.data() + 2 * slot * rawcnt_;
+    }
+
+    const RawSeqData *key_at(size_t slot) const {
+        return data_.data() + 2 * slot * rawcnt_;
+    }
+
+    RawSeqData *value_at(size_t slot) {
+        return key_at(slot) + rawcnt_;
+    }
+
+    const RawSeqData *value_at(size_t slot) const {
+        return key_at(slot) + rawcnt_;
+    }
+
+    size_t hash(const RawSeqData *key) const {
+        return Seq::GetHash(key, rawcnt_);
+    }
+
+    size_t find_slot(const RawSeqData *key) const {
+        if (!size_)
+            return -1ULL;
+
+        size_t mask = capacity() - 1;
+        for (size_t slot = hash(key) & mask; ; slot = (slot + 1) & mask) {
+            if (state_[slot] == Empty)
+                return -1ULL;
+            if (state_[slot] == Full &&
+                !memcmp(key_at(slot), key, rawcnt_ * sizeof(RawSeqData)))
+                return slot;
+        }
+    }
+
+    // The key must not be present in the map
+    size_t insert_slot(const RawSeqData *key) {
+        size_t mask = capacity() - 1;
+        size_t slot = hash(key) & mask;
+        while (state_[slot] == Full)
+            slot = (slot + 1) & mask;
+
+        if (state_[slot] == Deleted)
+            deleted_ -= 1;
+        state_[slot] = Full;
+        size_ += 1;
+
+        return slot;
+    }
+
+    // Rebuilds the table for at least the given number of entries dropping the deleted ones
+    void rehash(size_t size) {
+        size_t capacity = 16;
+        while (size * 4 > capacity * 3)
+            capacity *= 2;
+
+        std::vector<RawSeqData> data(2 * capacity * rawcnt_);
+        std::vector<uint8_t> state(capacity, Empty);
+        data.swap(data_);
+        state.swap(state_);
+        size_ = deleted_ = 0;
+
+        for (size_t i = 0; i < state.size(); ++i) {
+            if (state[i] != Full)
+                continue;
+
+            const RawSeqData *key = data.data() + 2 * i * rawcnt_;
+            size_t slot = insert_slot(key);
+            memcpy(key_at(slot), key, 2 * rawcnt_ * sizeof(RawSeqData));
+        }
+    }
 };
 
 }
@@ -168,6 +168,10 @@ public:
         if (rawval == nullptr)
             return kmer;
 
+        // After normalization all the values are the roots already
+        if (normalized_)
+            return Kmer(k_, rawval);
+
         const auto *newval = rawval;
         while (rawval != nullptr) {
             // VERIFY(answer != val);
@@ -197,6 +201,7 @@ public:
 
         uint32_t size;
         file.read((char *) &size, sizeof(uint32_t));
+        mapping_.reserve(size);
         for (uint32_t i = 0; i < size; ++i) {
             Kmer key(k_);
             Seq value(k_);
@@ -0,0 +1,260 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "assembly_graph/core/action_handlers.hpp"
+#include "assembly_graph/paths/mapping_path.hpp"
+#include "io/reads/binary_streams.hpp"
+#include "utils/filesystem/path_helper.hpp"
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace debruijn_graph {
+
+/*
+ * Persists the mapping paths of the reads of a library, so the subsequent
+ * passes over the very same read streams could replay them instead of mapping
+ * the reads once again. The paths of stream i are stored in file prefix_i in
+ * the order of the reads. Every path is varint-encoded, edge ids and ranges
+ * are stored as the deltas to the previous ones. Any change of the graph
+ * invalidates the cache.
+ */
+template<class Graph>
+class MappingCache : public omnigraph::GraphActionHandler<Graph> {
+    typedef omnigraph::GraphActionHandler<Graph> base;
+    typedef typename Graph::EdgeId EdgeId;
+    static constexpr size_t FLUSH_SIZE = 1 << 20;
+
+  public:
+    // Per-stream state, must be used by a single thread at a time
+    class Stream {
+      public:
+        // Records the path being computed by map(), or replays the recorded one
+        template<class MapF>
+        MappingPath<EdgeId> Map(MapF map) {
+            if (file_)
+                return Read();
+
+            MappingPath<EdgeId> path = map();
+            Write(path);
+            return path;
+        }
+
+      private:
+        friend class MappingCache;
+
+        std::string filename_;
+        std::ofstream out_;
+        std::vector<uint8_t> buf_;
+        std::unique_ptr<io::MappedBinaryFile> file_;
+        const uint8_t *pos_, *end_;
+
+        Stream(const std::string &filename, bool replay)
+                : filename_(filename), pos_(nullptr), end_(nullptr) {
+            if (replay) {
+                file_.reset(new io::MappedBinaryFile(filename_));
+                file_->AdviseSequential(0, file_->size());
+                pos_ = reinterpret_cast<const uint8_t*>(file_->data());
+                end_ = pos_ + file_->size();
+            } else {
+                out_.open(filename_, std::ios::binary | std::ios::trunc);
+                if (!out_)
+                    FATAL_ERROR("Cannot open mapping cache file " << filename_ << " for writing");
+                buf_.reserve(FLUSH_SIZE + 1024);
+            }
+        }
+
+        void Close() {
+            if (file_) {
+                VERIFY_MSG(pos_ == end_, "Mapping cache " << filename_ << " was not replayed completely");
+                return;
+            }
+            Flush();
+            out_.close();
+            if (!out_)
+                FATAL_ERROR("I/O error while writing mapping cache file " << filename_);
+        }
+
+        void Flush() {
+            out_.write(reinterpret_cast<const char*>(buf_.data()), buf_.size());
+            buf_.clear();
+        }
+
+        void PutVarint(uint64_t v) {
+            while (v >= 0x80) {
+                buf_.push_back(uint8_t(v | 0x80));
+                v >>= 7;
+            }
+            buf_.push_back(uint8_t(v));
+        }
+
+        void PutDelta(uint64_t to, uint64_t from) {
+            int64_t d = int64_t(to - from);
+            PutVarint(uint64_t(d << 1) ^ uint64_t(d >> 63));
+        }
+
+        uint64_t GetVarint() {
+            uint64_t v = 0;
+            for (unsigned shift = 0; ; shift += 7) {
+                VERIFY_MSG(pos_ < end_, "Mapping cache " << filename_ << " is truncated");
+                uint8_t b = *pos_++;
+                v |= uint64_t(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return v;
+            }
+        }
+
+        uint64_t GetDelta(uint64_t from) {
+            uint64_t z = GetVarint();
+            return from + ((z >> 1) ^ -(z & 1));
+        }
+
+        void Write(const MappingPath<EdgeId> &path) {
+            bool has_quality = false;
+            for (size_t i = 0; i < path.size(); ++i)
+                has_quality |= path.mapping_at(i).quality != 1.0;
+
+            PutVarint(path.size() << 1 | has_quality);
+            uint64_t prev_edge = 0, prev_end = 0;
+            for (size_t i = 0; i < path.size(); ++i) {
+                const MappingRange &range = path.mapping_at(i);
+                const Range &init = range.initial_range, &mapped = range.mapped_range;
+                PutDelta(path.edge_at(i).int_id(), prev_edge);
+                PutDelta(init.start_pos, prev_end);
+                PutVarint(init.end_pos - init.start_pos);
+                PutVarint(mapped.start_pos);
+                // Zero unless the mapping has indels
+                PutDelta(mapped.end_pos - mapped.start_pos, init.end_pos - init.start_pos);
+                if (has_quality) {
+                    size_t sz = buf_.size();
+                    buf_.resize(sz + sizeof(double));
+                    memcpy(buf_.data() + sz, &range.quality, sizeof(double));
+                }
+                prev_edge = path.edge_at(i).int_id();
+                prev_end = init.end_pos;
+            }
+
+            if (buf_.size() >= FLUSH_SIZE)
+                Flush();
+        }
+
+        MappingPath<EdgeId> Read() {
+            uint64_t header = GetVarint();
+            size_t size = header >> 1;
+            bool has_quality = header & 1;
+
+            std::vector<EdgeId> edges(size);
+            std::vector<MappingRange> ranges(size);
+            uint64_t prev_edge = 0, prev_end = 0;
+            for (size_t i = 0; i < size; ++i) {
+                edges[i] = EdgeId(GetDelta(prev_edge));
+                size_t start = GetDelta(prev_end);
+                size_t len = GetVarint();
+                size_t mapped_start = GetVarint();
+                size_t mapped_len = GetDelta(len);
+                double quality = 1.0;
+                if (has_quality) {
+                    VERIFY_MSG(pos_ + sizeof(double) <= end_, "Mapping cache " << filename_ << " is truncated");
+                    memcpy(&quality, pos_, sizeof(double));
+                    pos_ += sizeof(double);
+                }
+                ranges[i] = MappingRange(start, start + len, mapped_start, mapped_start + mapped_len, quality);
+                prev_edge = edges[i].int_id();
+                prev_end = start + len;
+            }
+
+            return MappingPath<EdgeId>(edges, ranges);
+        }
+    };
+
+    MappingCache(const Graph &g, const std::string &prefix)
+            : base(g, "MappingCache"), prefix_(prefix), recorded_(0), valid_(false) {}
+
+    ~MappingCache() {
+        streams_.clear();
+        Clear();
+    }
+
+    // Whether the paths of the given number of streams were recorded for the current graph
+    bool valid(size_t stream_count) const {
+        return valid_ && recorded_ == stream_count;
+    }
+
+    // Opens the streams either for replay (if the cache is valid) or for recording
+    void Open(size_t stream_count) {
+        VERIFY(streams_.empty());
+        bool replay = valid(stream_count);
+        if (!replay) {
+            Clear();
+            recorded_ = stream_count;
+        }
+
+        for (size_t i = 0; i < stream_count; ++i)
+            streams_.emplace_back(new Stream(filename(i), replay));
+    }
+
+    Stream &stream(size_t i) {
+        return *streams_[i];
+    }
+
+    // Finishes the pass over all the streams opened
+    void Close() {
+        for (auto &stream : streams_)
+            stream->Close();
+
+        if (!valid_) {
+            size_t total = 0;
+            for (size_t i = 0; i < streams_.size(); ++i)
+                total += fs::filesize(filename(i));
+            INFO("Mapping paths cached, " << total << " bytes");
+        }
+        valid_ = true;
+        streams_.clear();
+    }
+
+    void HandleAdd(EdgeId) override {
+        Invalidate();
+    }
+
+    void HandleDelete(EdgeId) override {
+        Invalidate();
+    }
+
+    using base::HandleAdd;
+    using base::HandleDelete;
+
+  private:
+    std::string prefix_;
+    size_t recorded_;
+    bool valid_;
+    std::vector<std::unique_ptr<Stream>> streams_;
+
+    std::string filename(size_t i) const {
+        return prefix_ + "_" + std::to_string(i);
+    }
+
+    void Invalidate() {
+        VERIFY_MSG(streams_.empty(), "Graph was modified during the read mapping");
+        valid_ = false;
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < recorded_; ++i)
+            fs::remove_if_exists(filename(i));
+        recorded_ = 0;
+        valid_ = false;
+    }
+};
+
+}
@@ -17,6 +17,7 @@
 #include "edge_index.hpp"
 #include "kmer_mapper.hpp"
 
+#include <array>
 #include <cstdlib>
 
 namespace debruijn_graph {
@@ -296,9 +297,18 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
   size_t k_;
   bool optimization_on_;
 
-  bool FindKmer(const Kmer &kmer, size_t kmer_pos, std::vector<EdgeId> &passed,
+  typedef std::pair<EdgeId, size_t> KmerPosition;
+  // Number of k-mers looked up at once after a miss
+  static const size_t LOOKUP_BATCH = 16;
+
+  struct LookupBatch {
+    std::array<Kmer, LOOKUP_BATCH> kmers;
+    std::array<bool, LOOKUP_BATCH> substituted;
+    std::array<KmerPosition, LOOKUP_BATCH> positions;
+  };
+
+  bool FindKmer(const KmerPosition &position, size_t kmer_pos, std::vector<EdgeId> &passed,
                 RangeMappings& range_mappings) const {
-    const auto& position = index_.get(kmer);
     if (position.second == -1u)
         return false;
     
@@ -348,23 +358,22 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
     return false;
   }
 
-  bool ProcessKmer(const Kmer &kmer, size_t kmer_pos, std::vector<EdgeId> &passed_edges,
-                   RangeMappings& range_mapping, bool try_thread) const {
-    if (try_thread) {
-        if (!TryThread(kmer, kmer_pos, passed_edges, range_mapping)) {
-            FindKmer(kmer_mapper_.Substitute(kmer), kmer_pos, passed_edges, range_mapping);
-            return false;
-        }
-
-        return true;
+  // Looks up the k-mers starting at positions [from, from + count) of the
+  // sequence, kmer is the one at position from. Substituted k-mers are looked
+  // up instead of the original ones.
+  void LookupKmers(const Sequence &sequence, size_t from, size_t count, Kmer kmer,
+                   LookupBatch &batch) const {
+    VERIFY(count <= LOOKUP_BATCH);
+    for (size_t i = 0; i < count; ++i) {
+      if (i)
+        kmer <<= sequence[from + i + k_ - 1];
+      batch.kmers[i] = kmer_mapper_.Substitute(kmer);
+      batch.substituted[i] = batch.kmers[i] != kmer;
     }
-
-    if (kmer_mapper_.CanSubstitute(kmer)) {
-        FindKmer(kmer_mapper_.Substitute(kmer), kmer_pos, passed_edges, range_mapping);
-        return false;
-    }
-
-    return FindKmer(kmer, kmer_pos, passed_edges, range_mapping);
+    if (count == 1)
+      batch.positions[0] = index_.get(batch.kmers[0]);
+    else
+      index_.get(batch.kmers.data(), count, batch.positions.data());
   }
 
  public:
@@ -385,14 +394,36 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
       return MappingPath<EdgeId>();
     }
 
+    // Threading along the current edge is the fast path. Otherwise the k-mer
+    // is looked up in the index; after a miss the subsequent k-mers are likely
+    // to miss as well (e.g. up to k of them after a sequencing error), so they
+    // are looked up in batch.
+    LookupBatch batch;
+    size_t batch_from = 0, batch_to = 0;
+    bool try_thread = false, missed = false;
+
+    size_t kmer_count = sequence.size() - k_ + 1;
     Kmer kmer = sequence.start<Kmer>(k_);
-    bool try_thread = false;
-    try_thread = ProcessKmer(kmer, 0, passed_edges,
-                             range_mapping, try_thread);
-    for (size_t i = k_; i < sequence.size(); ++i) {
-      kmer <<= sequence[i];
-      try_thread = ProcessKmer(kmer, i - k_ + 1, passed_edges,
-                               range_mapping, try_thread);
+    for (size_t pos = 0; pos < kmer_count; ++pos) {
+      if (pos)
+        kmer <<= sequence[pos + k_ - 1];
+
+      if (try_thread && TryThread(kmer, pos, passed_edges, range_mapping)) {
+        missed = false;
+      } else {
+        if (pos >= batch_to) {
+          batch_from = pos;
+          batch_to = pos + (missed ? std::min(size_t(LOOKUP_BATCH), kmer_count - pos) : 1);
+          LookupKmers(sequence, batch_from, batch_to - batch_from, kmer, batch);
+        }
+
+        size_t i = pos - batch_from;
+        bool found = FindKmer(batch.positions[i], pos, passed_edges, range_mapping);
+        // Threading is not tried right after the failed one or after the substitution
+        try_thread = !try_thread && !batch.substituted[i] && found;
+        missed = !found;
+      }
+
       if (only_simple && passed_edges.size() > 1)
         return MappingPath<EdgeId>();
     }
@@ -9,16 +9,26 @@
 #define SEQUENCE_MAPPER_NOTIFIER_HPP_
 
 #include "sequence_mapper.hpp"
+#include "mapping_cache.hpp"
 #include "io/reads/paired_read.hpp"
 #include "io/reads/read_stream_vector.hpp"
 #include "pipeline/graph_pack.hpp"
 #include "common/utils/memory_limit.hpp"
 
+#include "threadpool/threadpool.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
 #include <vector>
 #include <cstdlib>
 
 namespace debruijn_graph {
 //todo think if we still need all this
+// Reads are processed into the per-thread buffers of the listeners: the number
+// of buffers is passed to StartProcessLibrary, the buffer index is passed as
+// thread_index. MergeBuffer might be called concurrently with the processing
+// into the other buffers, but never concurrently with another MergeBuffer.
 class SequenceMapperListener {
 public:
     virtual void StartProcessLibrary(size_t /* threads_count */) {}
@@ -41,6 +51,7 @@ class SequenceMapperNotifier {
     static constexpr size_t BUFFER_SIZE = 200000;
 public:
     typedef SequenceMapper<conj_graph_pack::graph_t> SequenceMapperT;
+    typedef MappingCache<conj_graph_pack::graph_t> MappingCacheT;
 
     typedef std::vector<SequenceMapperListener*> ListenersContainer;
 
@@ -55,49 +66,97 @@ public:
     template<class ReadType>
     void ProcessLibrary(io::ReadStreamList<ReadType>& streams,
                         size_t lib_index, const SequenceMapperT& mapper, size_t threads_count = 0) {
+        DoProcessLibrary(streams, lib_index, mapper, nullptr, threads_count);
+    }
+
+    // Same as above, but the mapping paths are recorded into the cache on the
+    // first pass over the streams and replayed from it on the subsequent ones
+    template<class ReadType>
+    void ProcessLibrary(io::ReadStreamList<ReadType>& streams,
+                        size_t lib_index, const SequenceMapperT& mapper,
+                        MappingCacheT &cache, size_t threads_count = 0) {
+        DoProcessLibrary(streams, lib_index, mapper, &cache, threads_count);
+    }
+
+private:
+    template<class ReadType>
+    void DoProcessLibrary(io::ReadStreamList<ReadType>& streams,
+                          size_t lib_index, const SequenceMapperT& mapper,
+                          MappingCacheT *cache, size_t threads_count) {
         if (threads_count == 0)
             threads_count = streams.size();
 
         streams.reset();
-        NotifyStartProcessLibrary(lib_index, threads_count);
-        size_t counter = 0, n = 15;
-
-        #pragma omp parallel for num_threads(threads_count) shared(counter)
+        if (cache) {
+            if (cache->valid(streams.size()))
+                INFO("Using cached mapping paths");
+            cache->Open(streams.size());
+        }
+        // Every stream fills two buffers in turn: while one of them is being
+        // merged in background, the reads are processed into the other one.
+        // Listeners merge into the shared storages, so all the merges are
+        // serialized on a single worker.
+        size_t buffers_count = 2 * streams.size();
+        NotifyStartProcessLibrary(lib_index, buffers_count);
+        if (!merge_pool_)
+            merge_pool_.reset(new ThreadPool::ThreadPool(1));
+        std::vector<std::future<void>> merges(buffers_count);
+        std::atomic<size_t> counter{0};
+
+        #pragma omp parallel for num_threads(threads_count)
         for (size_t i = 0; i < streams.size(); ++i) {
-            size_t size = 0;
+            size_t size = 0, buffer = 2 * i;
             ReadType r;
             auto& stream = streams[i];
+            MappingCacheT::Stream *cache_stream = cache ? &cache->stream(i) : nullptr;
             while (!stream.eof()) {
                 if (size == BUFFER_SIZE) {
-                    #pragma omp critical
-                    {
-                        counter += size;
-                        if (counter >> n) {
-                            INFO("Processed " << counter << " reads");
-                            n += 1;
-                        }
-                        size = 0;
-                        NotifyMergeBuffer(lib_index, i);
-                    }
+                    ReportProgress(counter, size);
+                    size = 0;
+                    merges[buffer] = merge_pool_->run([this, lib_index, buffer] {
+                        NotifyMergeBuffer(lib_index, buffer);
+                    });
+                    buffer ^= 1;
+                    if (merges[buffer].valid())
+                        merges[buffer].get();
                 }
                 stream >> r;
                 ++size;
-                NotifyProcessRead(r, mapper, lib_index, i);
+                NotifyProcessRead(r, mapper, cache_stream, lib_index, buffer);
             }
-            #pragma omp atomic
             counter += size;
         }
 
-        for (size_t i = 0; i < threads_count; ++i)
+        for (auto &merge : merges) {
+            if (merge.valid())
+                merge.get();
+        }
+        for (size_t i = 0; i < buffers_count; ++i)
             NotifyMergeBuffer(lib_index, i);
 
+        if (cache)
+            cache->Close();
+
         INFO("Total " << counter << " reads processed");
         NotifyStopProcessLibrary(lib_index);
     }
 
-private:
+    static void ReportProgress(std::atomic<size_t> &counter, size_t size) {
+        size_t prev = counter.fetch_add(size);
+        size_t total = prev + size;
+        // Report every time the counter passes the next power of two
+        if ((total >> 15) && (prev ^ total) > prev)
+            INFO("Processed " << total << " reads");
+    }
+
+    template<class MapF>
+    static MappingPath<EdgeId> Map(MappingCacheT::Stream *cache, MapF map) {
+        return cache ? cache->Map(map) : map();
+    }
+
     template<class ReadType>
-    void NotifyProcessRead(const ReadType& r, const SequenceMapperT& mapper, size_t ilib, size_t ithread) const;
+    void NotifyProcessRead(const ReadType& r, const SequenceMapperT& mapper, MappingCacheT::Stream *cache,
+                           size_t ilib, size_t ithread) const;
 
     void NotifyStartProcessLibrary(size_t ilib, size_t thread_count) const {
         for (const auto& listener : listeners_[ilib])
@@ -116,18 +175,20 @@ private:
     const conj_graph_pack& gp_;
 
     std::vector<std::vector<SequenceMapperListener*> > listeners_;  //first vector's size = count libs
+    std::unique_ptr<ThreadPool::ThreadPool> merge_pool_;
 };
 
 template<>
 inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r,
                                                       const SequenceMapperT& mapper,
+                                                      MappingCacheT::Stream *cache,
                                                       size_t ilib,
                                                       size_t ithread) const {
 
     const Sequence& read1 = r.first().sequence();
     const Sequence& read2 = r.second().sequence();
-    MappingPath<EdgeId> path1 = mapper.MapSequence(read1);
-    MappingPath<EdgeId> path2 = mapper.MapSequence(read2);
+    MappingPath<EdgeId> path1 = Map(cache, [&] { return mapper.MapSequence(read1); });
+    MappingPath<EdgeId> path2 = Map(cache, [&] { return mapper.MapSequence(read2); });
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
@@ -138,10 +199,11 @@ inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedReadSeq& r
 template<>
 inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
                                                       const SequenceMapperT& mapper,
+                                                      MappingCacheT::Stream *cache,
                                                       size_t ilib,
                                                       size_t ithread) const {
-    MappingPath<EdgeId> path1 = mapper.MapRead(r.first());
-    MappingPath<EdgeId> path2 = mapper.MapRead(r.second());
+    MappingPath<EdgeId> path1 = Map(cache, [&] { return mapper.MapRead(r.first()); });
+    MappingPath<EdgeId> path2 = Map(cache, [&] { return mapper.MapRead(r.second()); });
     for (const auto& listener : listeners_[ilib]) {
         listener->ProcessPairedRead(ithread, r, path1, path2);
         listener->ProcessSingleRead(ithread, r.first(), path1);
@@ -152,10 +214,11 @@ inline void SequenceMapperNotifier::NotifyProcessRead(const io::PairedRead& r,
 template<>
 inline void SequenceMapperNotifier::NotifyProcessRead(const io::SingleReadSeq& r,
                                                       const SequenceMapperT& mapper,
+                                                      MappingCacheT::Stream *cache,
                                                       size_t ilib,
                                                       size_t ithread) const {
     const Sequence& read = r.sequence();
-    MappingPath<EdgeId> path = mapper.MapSequence(read);
+    MappingPath<EdgeId> path = Map(cache, [&] { return mapper.MapSequence(read); });
     for (const auto& listener : listeners_[ilib])
         listener->ProcessSingleRead(ithread, r, path);
 }
@@ -163,9 +226,10 @@ inline void SequenceMapperNotifier::NotifyProcessRead(const io::SingleReadSeq& r
 template<>
 inline void SequenceMapperNotifier::NotifyProcessRead(const io::SingleRead& r,
                                                       const SequenceMapperT& mapper,
+                                                      MappingCacheT::Stream *cache,
                                                       size_t ilib,
                                                       size_t ithread) const {
-    MappingPath<EdgeId> path = mapper.MapRead(r);
+    MappingPath<EdgeId> path = Map(cache, [&] { return mapper.MapRead(r); });
     for (const auto& listener : listeners_[ilib])
         listener->ProcessSingleRead(ithread, r, path);
 }
@@ -16,6 +16,7 @@
 #define IDEAL_PAIR_INFO_HPP_
 #include <vector>
 #include "pipeline/graph_pack.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace path_extend {
 
@@ -29,7 +30,8 @@ public:
             : g_(g),
               d_min_(d_min),
               d_max_(d_max),
-              read_size_(read_size) {
+              read_size_(read_size),
+              pi_(omp_get_max_threads()) {
         size_t sum = 0;
         for (auto iter = is_distribution.begin(); iter != is_distribution.end();
                 ++iter) {
@@ -44,11 +46,17 @@ public:
     }
 
     double IdealPairedInfo(EdgeId e1, EdgeId e2, int dist, bool additive = false) const {
+        size_t thread = omp_get_thread_num();
+        //Threads beyond the ones there were at construction do not cache
+        if (thread >= pi_.size())
+            return IdealPairedInfo(g_.length(e1), g_.length(e2), dist, additive);
+
         std::pair<size_t, size_t> lengths{g_.length(e1), g_.length(e2)};
-        if (pi_.find(lengths) == pi_.end()) {
-            pi_.insert({lengths, {}});
+        auto &pi = pi_[thread];
+        if (pi.find(lengths) == pi.end()) {
+            pi.insert({lengths, {}});
         }
-        std::map<int, double> &weights = pi_[lengths];
+        std::map<int, double> &weights = pi[lengths];
         if (weights.find(dist) == weights.end()) {
             weights.emplace(dist, IdealPairedInfo(g_.length(e1), g_.length(e2), dist, additive));
         }
@@ -120,7 +128,8 @@ private:
     size_t read_size_;
     std::vector<double> weights_;
     std::map<int, double> insert_size_distrib_;
-    mutable std::map<std::pair<size_t, size_t>, std::map<int, double> > pi_;
+    // Per-thread caches, indexed by omp_get_thread_num()
+    mutable std::vector<std::map<std::pair<size_t, size_t>, std::map<int, double> > > pi_;
     std::vector<double> not_total_weights_right_;
     std::vector<double> not_total_weights_left_;
 protected:
@@ -19,7 +19,10 @@
 #include "path_filter.hpp"
 #include "overlap_analysis.hpp"
 #include "assembly_graph/graph_support/scaff_supplementary.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/parallel/thread_local_ptr.hpp"
 #include <cmath>
+#include <unordered_set>
 
 namespace path_extend {
 
@@ -696,11 +699,109 @@ private:
 
 //Detects a cycle as a minsuffix > IS present earlier in the path. Overlap is allowed.
 class InsertSizeLoopDetector {
+public:
+    /*
+     * Cycles found by a thread in the speculative mode (see StartSpeculation())
+     * are kept in the log instead of the detectors, so that several paths
+     * could be grown concurrently and their cycles committed later in the
+     * required order (see Commit()). The log is shared by all the detectors,
+     * the edges the known cycles are looked up by are logged too.
+     */
+    class SpeculationLog {
+      public:
+        SpeculationLog() {}
+
+        SpeculationLog(const SpeculationLog&) = delete;
+        SpeculationLog& operator=(const SpeculationLog&) = delete;
+
+        ~SpeculationLog() {
+            clear();
+        }
+
+        const std::vector<EdgeId> &looked_up() const {
+            return looked_up_;
+        }
+
+        // Paths of the cycles found (each followed by its conjugate)
+        std::vector<BidirectionalPath*> paths() const {
+            std::vector<BidirectionalPath*> result;
+            for (const auto &cycle : cycles_) {
+                result.push_back(cycle.path);
+                result.push_back(cycle.conj_path);
+            }
+            return result;
+        }
+
+        void clear() {
+            for (const auto &cycle : cycles_) {
+                delete cycle.path;
+                delete cycle.conj_path;
+            }
+            cycles_.clear();
+            looked_up_.clear();
+        }
+
+      private:
+        friend class InsertSizeLoopDetector;
+
+        struct Cycle {
+            InsertSizeLoopDetector *detector;
+            BidirectionalPath *path;
+            BidirectionalPath *conj_path;
+        };
+
+        std::vector<Cycle> cycles_;
+        std::vector<EdgeId> looked_up_;
+    };
+
 protected:
     GraphCoverageMap visited_cycles_coverage_map_;
     PathContainer path_storage_;
     size_t min_cycle_len_;
 
+    typedef utils::ThreadLocalPtr<SpeculationLog> CurrentLog;
+
+    bool InCycle(const BidirectionalPath& path, const BidirectionalPath *cycle) const {
+        DEBUG("checking  cycle ");
+        int pos = path.FindLast(*cycle);
+        if (pos == -1)
+            return false;
+
+        int start_cycle_pos = pos + (int) cycle->Size();
+        bool only_cycles_in_tail = true;
+        int last_cycle_pos = start_cycle_pos;
+        DEBUG("start_cycle pos "<< last_cycle_pos);
+        for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle->Size(); i += (int) cycle->Size()) {
+            if (!path.CompareFrom(i, *cycle)) {
+                only_cycles_in_tail = false;
+                break;
+            } else {
+                last_cycle_pos = i + (int) cycle->Size();
+                DEBUG("last cycle pos changed " << last_cycle_pos);
+            }
+        }
+        DEBUG("last_cycle_pos " << last_cycle_pos);
+        only_cycles_in_tail = only_cycles_in_tail && cycle->CompareFrom(0, path.SubPath(last_cycle_pos));
+        if (only_cycles_in_tail) {
+// seems that most of this is useless, checking
+            VERIFY (last_cycle_pos == start_cycle_pos);
+            DEBUG("find cycle " << last_cycle_pos);
+            DEBUG("path");
+            path.PrintDEBUG();
+            DEBUG("last subpath");
+            path.SubPath(last_cycle_pos).PrintDEBUG();
+            DEBUG("cycle");
+            cycle->PrintDEBUG();
+            DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
+            VERIFY(last_cycle_pos <= (int)path.Size());
+            DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle->Size());
+            VERIFY(last_cycle_pos + (int)cycle->Size() >= (int)path.Size());
+
+            return true;
+        }
+        return false;
+    }
+
 public:
     InsertSizeLoopDetector(const Graph& g, size_t is):
         visited_cycles_coverage_map_(g),
@@ -774,44 +875,24 @@ public:
     //seems that it is outofdate
     bool InExistingLoop(const BidirectionalPath& path) {
         DEBUG("Checking existing loops");
+        SpeculationLog *log = CurrentLog::get();
+        if (log)
+            log->looked_up_.push_back(path.Back());
+
         auto visited_cycles = visited_cycles_coverage_map_.GetEdgePaths(path.Back());
         for (auto cycle : *visited_cycles) {
-            DEBUG("checking  cycle ");
-            int pos = path.FindLast(*cycle);
-            if (pos == -1)
-                continue;
-
-            int start_cycle_pos = pos + (int) cycle->Size();
-            bool only_cycles_in_tail = true;
-            int last_cycle_pos = start_cycle_pos;
-            DEBUG("start_cycle pos "<< last_cycle_pos);
-            for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle->Size(); i += (int) cycle->Size()) {
-                if (!path.CompareFrom(i, *cycle)) {
-                    only_cycles_in_tail = false;
-                    break;
-                } else {
-                    last_cycle_pos = i + (int) cycle->Size();
-                    DEBUG("last cycle pos changed " << last_cycle_pos);
-                }
-            }
-            DEBUG("last_cycle_pos " << last_cycle_pos);
-            only_cycles_in_tail = only_cycles_in_tail && cycle->CompareFrom(0, path.SubPath(last_cycle_pos));
-            if (only_cycles_in_tail) {
-// seems that most of this is useless, checking
-                VERIFY (last_cycle_pos == start_cycle_pos);
-                DEBUG("find cycle " << last_cycle_pos);
-                DEBUG("path");
-                path.PrintDEBUG();
-                DEBUG("last subpath");
-                path.SubPath(last_cycle_pos).PrintDEBUG();
-                DEBUG("cycle");
-                cycle->PrintDEBUG();
-                DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
-                VERIFY(last_cycle_pos <= (int)path.Size());
-                DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle->Size());
-                VERIFY(last_cycle_pos + (int)cycle->Size() >= (int)path.Size());
-
+            if (InCycle(path, cycle))
                 return true;
+        }
+
+        if (log) {
+            for (const auto &cycle : log->cycles_) {
+                if (cycle.detector != this)
+                    continue;
+                if (cycle.path->FindFirst(path.Back()) != -1 && InCycle(path, cycle.path))
+                    return true;
+                if (cycle.conj_path->FindFirst(path.Back()) != -1 && InCycle(path, cycle.conj_path))
+                    return true;
             }
         }
         return false;
@@ -824,11 +905,35 @@ public:
         }
         BidirectionalPath * p = new BidirectionalPath(path.SubPath(pos));
         BidirectionalPath * cp = new BidirectionalPath(p->Conjugate());
-        visited_cycles_coverage_map_.Subscribe(p);
-        visited_cycles_coverage_map_.Subscribe(cp);
+        if (SpeculationLog *log = CurrentLog::get()) {
+            log->cycles_.push_back({this, p, cp});
+        } else {
+            visited_cycles_coverage_map_.Subscribe(p);
+            visited_cycles_coverage_map_.Subscribe(cp);
+        }
         DEBUG("add cycle");
         p->PrintDEBUG();
     }
+
+    // Starts logging the cycles found by the current thread instead of adding them
+    static void StartSpeculation(SpeculationLog &log) {
+        CurrentLog::set(&log);
+    }
+
+    static void StopSpeculation() {
+        VERIFY(CurrentLog::get());
+        CurrentLog::set(nullptr);
+    }
+
+    // Adds the cycles logged to their detectors
+    static void Commit(SpeculationLog &log) {
+        for (const auto &cycle : log.cycles_) {
+            cycle.detector->visited_cycles_coverage_map_.Subscribe(cycle.path);
+            cycle.detector->visited_cycles_coverage_map_.Subscribe(cycle.conj_path);
+        }
+        log.cycles_.clear();
+        log.looked_up_.clear();
+    }
 };
 
 class PathExtender {
@@ -845,6 +950,14 @@ protected:
     DECL_LOGGER("PathExtender")
 };
 
+/*
+ * Seeds are grown speculatively in windows: the seeds of a window are grown
+ * concurrently against the state of the coverage map and the storages at the
+ * window start, then committed one by one in the seed order. A seed whose
+ * growth looked up anything changed by the seeds committed before it is
+ * regrown against the current state, so the result is the same as if the
+ * seeds were grown one after another (path ids included).
+ */
 class CompositeExtender {
 public:
 
@@ -868,6 +981,27 @@ public:
 
 
 private:
+    static const size_t SEEDS_PER_THREAD = 4;
+    // Paths created while growing a seed are numbered from here till the growth is committed
+    static const uint64_t FIRST_SPECULATIVE_ID = uint64_t(1) << 63;
+
+    // Paths created while growing a seed along with the changes to be made to the storages
+    struct SeedGrowth {
+        PathContainer paths;
+        UsedUniqueStorage::SpeculationLog used;
+        InsertSizeLoopDetector::SpeculationLog cycles;
+        //Paths being grown, subscribed to the coverage map on commit
+        std::vector<BidirectionalPath*> pending;
+        uint64_t next_id;
+    };
+
+    // Edges changed by the seeds committed since the window start
+    struct Changes {
+        std::unordered_set<EdgeId> covered;
+        std::unordered_set<EdgeId> used;
+        std::unordered_set<EdgeId> cycled;
+    };
+
     const Graph &g_;
     GraphCoverageMap &cover_map_;
     UsedUniqueStorage &used_storage_;
@@ -886,50 +1020,142 @@ private:
         }
         return false;
     }
-    
+
+    void GrowSeed(const PathContainer& paths, size_t i, SeedGrowth& growth) {
+        VERIFY(growth.paths.size() == 0);
+        growth.next_id = FIRST_SPECULATIVE_ID;
+        BidirectionalPath::SetIdSource(&growth.next_id);
+        used_storage_.StartSpeculation(growth.used);
+        InsertSizeLoopDetector::StartSpeculation(growth.cycles);
+
+        const BidirectionalPath &seed = *paths.Get(i);
+        bool was_used = false;
+        //In 2015 modes do not use a seed already used in paths.
+        //FIXME what is the logic here?
+        if (used_storage_.UniqueCheckEnabled()) {
+            for (size_t ind =0; ind < seed.Size(); ind++) {
+                EdgeId eid = seed.At(ind);
+                if (used_storage_.IsUsedAndUnique(eid)) {
+                    DEBUG("Used edge " << g_.int_id(eid));
+                    was_used = true;
+                    break;
+                } else {
+                    used_storage_.insert(eid);
+                }
+            }
+            if (was_used) {
+                DEBUG("skipping already used seed");
+            }
+        }
+
+        if (!was_used && !cover_map_.IsCovered(seed)) {
+            //The first two pairs are added to the coverage map on commit
+            BidirectionalPath * p = new BidirectionalPath(seed);
+            BidirectionalPath * conj_p = new BidirectionalPath(OptimizedConjugate(seed));
+            growth.paths.AddPair(p, conj_p);
+            BidirectionalPath * path = new BidirectionalPath(seed);
+            BidirectionalPath * conjugatePath = new BidirectionalPath(*paths.GetConjugate(i));
+            growth.paths.AddPair(path, conjugatePath);
+            growth.pending = {path, conjugatePath};
+            GraphCoverageMap::SetPendingPaths(&growth.pending);
+            size_t count_trying = 0;
+            size_t current_path_len = 0;
+            do {
+                current_path_len = path->Length();
+                count_trying++;
+                GrowPath(*path, &growth.paths);
+                GrowPath(*conjugatePath, &growth.paths);
+            } while (count_trying < 10 && (path->Length() != current_path_len));
+            DEBUG("result path " << path->GetId());
+            path->PrintDEBUG();
+        }
+
+        GraphCoverageMap::SetPendingPaths(nullptr);
+        InsertSizeLoopDetector::StopSpeculation();
+        used_storage_.StopSpeculation();
+        BidirectionalPath::SetIdSource(nullptr);
+    }
+
+    bool Affected(const BidirectionalPath& seed, const SeedGrowth& growth, const Changes& changes) const {
+        //Coverage only grows, so the covered seeds stay covered
+        if (growth.paths.size() > 0) {
+            for (EdgeId e : seed) {
+                if (changes.covered.count(e))
+                    return true;
+            }
+        }
+        for (EdgeId e : growth.used.looked_up()) {
+            if (changes.used.count(e))
+                return true;
+        }
+        for (EdgeId e : growth.cycles.looked_up()) {
+            if (changes.cycled.count(e))
+                return true;
+        }
+        return false;
+    }
+
+    void Discard(SeedGrowth& growth) const {
+        growth.pending.clear();
+        growth.paths.DeleteAllPaths();
+        growth.used.clear();
+        growth.cycles.clear();
+    }
+
+    void Commit(SeedGrowth& growth, PathContainer& result, Changes& changes) {
+        uint64_t first_id = BidirectionalPath::ReserveIds(growth.next_id - FIRST_SPECULATIVE_ID);
+        auto renumber = [=](BidirectionalPath *p) {
+            p->SetId(first_id + (p->GetId() - FIRST_SPECULATIVE_ID));
+        };
+        for (auto iter = growth.paths.begin(); iter != growth.paths.end(); ++iter) {
+            renumber(iter.get());
+            renumber(iter.getConjugate());
+        }
+        for (BidirectionalPath *p : growth.cycles.paths()) {
+            renumber(p);
+            changes.cycled.insert(p->begin(), p->end());
+        }
+
+        for (size_t i = 0; i < std::min(growth.paths.size(), size_t(2)); ++i) {
+            for (BidirectionalPath *p : {growth.paths.Get(i), growth.paths.GetConjugate(i)}) {
+                SubscribeCoverageMap(p, cover_map_);
+                changes.covered.insert(p->begin(), p->end());
+            }
+        }
+        changes.used.insert(growth.used.used().begin(), growth.used.used().end());
+
+        used_storage_.Commit(growth.used);
+        growth.used.clear();
+        growth.pending.clear();
+        InsertSizeLoopDetector::Commit(growth.cycles);
+        result.MoveAll(growth.paths);
+    }
+
     void GrowAllPaths(PathContainer& paths, PathContainer& result) {
-        for (size_t i = 0; i < paths.size(); ++i) {
-            VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-            if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
-                INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
+        size_t threads = omp_get_max_threads();
+        size_t window = threads > 1 ? threads * SEEDS_PER_THREAD : 1;
+        std::vector<SeedGrowth> growths(window);
+
+        for (size_t start = 0; start < paths.size(); start += window) {
+            size_t end = std::min(start + window, paths.size());
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = start; i < end; ++i) {
+                GrowSeed(paths, i, growths[i - start]);
             }
-            //In 2015 modes do not use a seed already used in paths.
-            //FIXME what is the logic here?
-            if (used_storage_.UniqueCheckEnabled()) {
-                bool was_used = false;
-                for (size_t ind =0; ind < paths.Get(i)->Size(); ind++) {
-                    EdgeId eid = paths.Get(i)->At(ind);
-                    if (used_storage_.IsUsedAndUnique(eid)) {
-                        DEBUG("Used edge " << g_.int_id(eid));
-                        was_used = true;
-                        break;
-                    } else {
-                        used_storage_.insert(eid);
-                    }
+
+            Changes changes;
+            for (size_t i = start; i < end; ++i) {
+                VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
+                if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
+                    INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
                 }
-                if (was_used) {
-                    DEBUG("skipping already used seed");
-                    continue;
+                SeedGrowth &growth = growths[i - start];
+                if (Affected(*paths.Get(i), growth, changes)) {
+                    DEBUG("Regrowing seed " << i);
+                    Discard(growth);
+                    GrowSeed(paths, i, growth);
                 }
-            }
-
-            if (!cover_map_.IsCovered(*paths.Get(i))) {
-                AddPath(result, *paths.Get(i), cover_map_);
-                BidirectionalPath * path = new BidirectionalPath(*paths.Get(i));
-                BidirectionalPath * conjugatePath = new BidirectionalPath(*paths.GetConjugate(i));
-                SubscribeCoverageMap(path, cover_map_);
-                SubscribeCoverageMap(conjugatePath, cover_map_);
-                result.AddPair(path, conjugatePath);
-                size_t count_trying = 0;
-                size_t current_path_len = 0;
-                do {
-                    current_path_len = path->Length();
-                    count_trying++;
-                    GrowPath(*path, &result);
-                    GrowPath(*conjugatePath, &result);
-                } while (count_trying < 10 && (path->Length() != current_path_len));
-                DEBUG("result path " << path->GetId());
-                path->PrintDEBUG();
+                Commit(growth, result, changes);
             }
         }
     }
@@ -15,6 +15,7 @@
 #pragma once
 
 #include "path_extender.hpp"
+#include "adt/concurrent_dsu.hpp"
 
 namespace path_extend {
 
@@ -25,14 +26,99 @@ inline void PopFront(BidirectionalPath * const path, size_t cnt) {
     path->GetConjPath()->PopBack(cnt);
 }
 
+//Overlap candidates of the container paths, looked up in the coverage map once.
+//Path 2 * i is the i-th path of the container, path 2 * i + 1 is its conjugate.
+class PathCandidates {
+    std::vector<PathPtr> paths_;
+    std::unordered_map<PathPtr, size_t> indices_;
+    std::vector<std::vector<PathPtr>> candidates_;
+
+public:
+    static const size_t NO_INDEX = -1ul;
+
+    PathCandidates(const PathContainer &paths, const OverlapFindingHelper &helper,
+                   bool conjugate_candidates = true) :
+            candidates_(2 * paths.size()) {
+        paths_.reserve(2 * paths.size());
+        for (const auto &path_pair : paths) {
+            paths_.push_back(path_pair.first);
+            paths_.push_back(path_pair.second);
+        }
+        indices_.reserve(paths_.size());
+        for (size_t i = 0; i < paths_.size(); ++i)
+            indices_.emplace(paths_[i], i);
+
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            if (conjugate_candidates || i % 2 == 0)
+                candidates_[i] = helper.FindCandidatePaths(*paths_[i]);
+        }
+    }
+
+    size_t size() const {
+        return paths_.size();
+    }
+
+    PathPtr path(size_t i) const {
+        return paths_[i];
+    }
+
+    //NO_INDEX for the paths not from the container
+    size_t index(PathPtr path) const {
+        auto it = indices_.find(path);
+        if (it == indices_.end())
+            return NO_INDEX;
+        return it->second;
+    }
+
+    const std::vector<PathPtr> &candidates(size_t i) const {
+        return candidates_[i];
+    }
+
+    //Groups indices of path pairs (i.e. i for paths 2 * i and 2 * i + 1) connected via candidates.
+    //Pairs within a group are kept in the container order, largest groups go first.
+    std::vector<std::vector<size_t>> PairComponents() const {
+        size_t pair_cnt = paths_.size() / 2;
+        dsu::ConcurrentDSU dsu(pair_cnt);
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            for (PathPtr candidate : candidates_[i]) {
+                size_t j = index(candidate);
+                if (j != NO_INDEX)
+                    dsu.unite(i / 2, j / 2);
+            }
+        }
+
+        std::vector<std::vector<size_t>> components;
+        //component index + 1 for the set representatives met so far
+        std::vector<size_t> component_ids(pair_cnt, 0);
+        for (size_t i = 0; i < pair_cnt; ++i) {
+            size_t &id = component_ids[dsu.find_set(i)];
+            if (id == 0) {
+                components.emplace_back();
+                id = components.size();
+            }
+            components[id - 1].push_back(i);
+        }
+        std::stable_sort(components.begin(), components.end(),
+                         [](const std::vector<size_t> &a, const std::vector<size_t> &b) {
+                             return a.size() > b.size();
+                         });
+        return components;
+    }
+};
+
 class OverlapRemover {
     const PathContainer &paths_;
     const OverlapFindingHelper helper_;
+    const PathCandidates candidates_;
+    //split positions of the paths indexed as in candidates_
+    std::vector<std::set<size_t>> path_splits_;
     SplitsStorage splits_;
 
     bool AlreadyAdded(PathPtr ptr, size_t pos) const {
-        auto it = splits_.find(ptr);
-        return it != splits_.end() && it->second.count(pos);
+        size_t i = candidates_.index(ptr);
+        return i != PathCandidates::NO_INDEX && path_splits_[i].count(pos);
     }
 
     //TODO if situation start ==0 && end==p.Size is not interesting then code can be simplified
@@ -88,27 +174,52 @@ class OverlapRemover {
         return overlap;
     }
 
-    void MarkStartOverlaps(const BidirectionalPath &path, bool end_start_only, bool retain_one_copy) {
-        std::set<size_t> overlap_poss;
-        for (PathPtr candidate : helper_.FindCandidatePaths(path)) {
+    void MarkStartOverlaps(size_t i, bool end_start_only, bool retain_one_copy) {
+        const BidirectionalPath &path = *candidates_.path(i);
+        for (PathPtr candidate : candidates_.candidates(i)) {
             size_t overlap = AnalyzeOverlaps(path, *candidate,
                                              end_start_only, retain_one_copy);
             if (overlap > 0) {
-                overlap_poss.insert(overlap);
+                path_splits_[i].insert(overlap);
             }
         }
-        if (!overlap_poss.empty()) {
-            utils::insert_all(splits_[&path], overlap_poss);
-        }
+    }
+
+    void MarkPairOverlaps(size_t pair_idx, bool end_start_only, bool retain_one_copy) {
+        //TODO think if this "optimization" is necessary
+        if (candidates_.path(2 * pair_idx)->Size() == 0)
+            return;
+        MarkStartOverlaps(2 * pair_idx, end_start_only, retain_one_copy);
+        MarkStartOverlaps(2 * pair_idx + 1, end_start_only, retain_one_copy);
     }
 
     void InnerMarkOverlaps(bool end_start_only, bool retain_one_copy) {
-        for (auto path_pair: paths_) {
-            //TODO think if this "optimization" is necessary
-            if (path_pair.first->Size() == 0)
-                continue;
-            MarkStartOverlaps(*path_pair.first, end_start_only, retain_one_copy);
-            MarkStartOverlaps(*path_pair.second, end_start_only, retain_one_copy);
+        size_t pair_cnt = candidates_.size() / 2;
+        if (!retain_one_copy) {
+            //only own splits are updated, paths can be processed in any order
+            #pragma omp parallel for schedule(guided)
+            for (size_t i = 0; i < pair_cnt; ++i)
+                MarkPairOverlaps(i, end_start_only, retain_one_copy);
+            return;
+        }
+
+        //splits of the candidates are checked, so paths connected via candidates
+        //are processed in the container order
+        auto components = candidates_.PairComponents();
+        DEBUG(components.size() << " path components, largest has " <<
+              (components.empty() ? 0 : components.front().size()) << " pairs");
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < components.size(); ++c) {
+            for (size_t i : components[c])
+                MarkPairOverlaps(i, end_start_only, retain_one_copy);
+        }
+    }
+
+    void CollectSplits() {
+        splits_.clear();
+        for (size_t i = 0; i < path_splits_.size(); ++i) {
+            if (!path_splits_[i].empty())
+                splits_[candidates_.path(i)] = path_splits_[i];
         }
     }
 
@@ -120,7 +231,9 @@ public:
                          size_t max_diff) :// = 0) :
             paths_(paths),
             helper_(g, coverage_map,
-                    min_edge_len, max_diff) {
+                    min_edge_len, max_diff),
+            candidates_(paths_, helper_),
+            path_splits_(candidates_.size()) {
     }
 
     //Note that during start/end removal all repeat instance have to be cut
@@ -133,6 +246,7 @@ public:
             INFO("Marking remaining overlaps");
             InnerMarkOverlaps(/*end/start overlaps only*/ false, retain_one_copy);
         }
+        CollectSplits();
     }
 
     const SplitsStorage& overlaps() const {
@@ -210,13 +324,20 @@ class PathDeduplicator {
     const bool equal_only_;
     const OverlapFindingHelper helper_;
 
-    bool IsRedundant(PathPtr path) const {
+    //Paths of the pairs already found redundant are not considered,
+    //as if they were cleared right away
+    bool IsRedundant(const PathCandidates &candidates, size_t pair_idx,
+                     const std::vector<uint8_t> &redundant) const {
+        PathPtr path = candidates.path(2 * pair_idx);
         TRACE("Checking if path redundant " << path->GetId());
-        for (auto candidate : helper_.FindCandidatePaths(*path)) {
+        for (auto candidate : candidates.candidates(2 * pair_idx)) {
             TRACE("Considering candidate " << candidate->GetId());
 //                VERIFY(candidate != path && candidate != path->GetConjPath());
             if (candidate == path || candidate == path->GetConjPath())
                 continue;
+            size_t idx = candidates.index(candidate);
+            if (idx != PathCandidates::NO_INDEX && redundant[idx / 2])
+                continue;
             if (equal_only_ ? helper_.IsEqual(*path, *candidate) : helper_.IsSubpath(*path, *candidate)) {
                 return true;
             }
@@ -238,11 +359,19 @@ public:
 
     //TODO use path container filtering?
     void Deduplicate() {
-        for (auto path_pair : paths_) {
-            auto path = path_pair.first;
-            if (IsRedundant(path)) {
-                TRACE("Clearing path " << path->str());
-                path->Clear();
+        PathCandidates candidates(paths_, helper_, /*conjugate candidates*/false);
+        std::vector<uint8_t> redundant(paths_.size(), false);
+        auto components = candidates.PairComponents();
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t c = 0; c < components.size(); ++c) {
+            for (size_t i : components[c])
+                redundant[i] = IsRedundant(candidates, i, redundant);
+        }
+
+        for (size_t i = 0; i < paths_.size(); ++i) {
+            if (redundant[i]) {
+                TRACE("Clearing path " << paths_.Get(i)->str());
+                paths_.Get(i)->Clear();
             }
         }
     }
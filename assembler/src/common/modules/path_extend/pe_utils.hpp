@@ -16,6 +16,9 @@
 #define PE_UTILS_HPP_
 
 #include "assembly_graph/paths/bidirectional_path.hpp"
+#include "assembly_graph/paths/bidirectional_path_container.hpp"
+#include "adt/small_pod_vector.hpp"
+#include "utils/parallel/thread_local_ptr.hpp"
 
 namespace path_extend {
 
@@ -40,32 +43,72 @@ inline bool InTwoEdgeCycle(EdgeId e, const Graph &g) {
 
 // Handles all paths in PathContainer.
 // For each edge output all paths  that _traverse_ this path. If path contains multiple instances - count them. Position of the edge is not reported.
+// Paths covering an edge (with multiplicity), ordered by id like BidirectionalPathMultiset.
+// Most edges are covered by a few paths, so a sorted compact array is enough.
+class CoveringPaths {
+    adt::SmallPODVector<BidirectionalPath *> paths_;
+
+public:
+    typedef adt::SmallPODVector<BidirectionalPath *>::const_iterator const_iterator;
+
+    const_iterator begin() const { return paths_.begin(); }
+    const_iterator end() const { return paths_.end(); }
+    size_t size() const { return paths_.size(); }
+    bool empty() const { return paths_.empty(); }
+
+    size_t count(const BidirectionalPath *path) const {
+        auto range = std::equal_range(begin(), end(), path, PathComparator());
+        return range.second - range.first;
+    }
+
+    void insert(BidirectionalPath *path) {
+        paths_.insert(std::upper_bound(begin(), end(), path, PathComparator()), path);
+    }
+
+    // Removes a single occurrence of the path
+    bool erase(const BidirectionalPath *path) {
+        auto it = std::lower_bound(begin(), end(), path, PathComparator());
+        if (it == end() || PathComparator()(path, *it))
+            return false;
+        paths_.erase(it);
+        return true;
+    }
+};
+
 class GraphCoverageMap: public PathListener {
 public:
-    typedef BidirectionalPathMultiset MapDataT;
+    typedef CoveringPaths MapDataT;
 
 private:
     const Graph& g_;
 
-    std::unordered_map<EdgeId, MapDataT * > edge_coverage_;
+    // Indexed by edge id
+    std::vector<MapDataT> edge_coverage_;
+    // Number of edges ever covered
+    size_t covered_edges_;
+    std::vector<bool> ever_covered_;
     const MapDataT empty_;
 
+    typedef utils::ThreadLocalPtr<const std::vector<BidirectionalPath*>, GraphCoverageMap> PendingPaths;
+
     void EdgeAdded(EdgeId e, BidirectionalPath * path) {
-        auto iter = edge_coverage_.find(e);
-        if (iter == edge_coverage_.end()) {
-            edge_coverage_.insert(std::make_pair(e, new MapDataT()));
+        size_t id = g_.int_id(e);
+        if (id >= edge_coverage_.size()) {
+            edge_coverage_.resize(id + 1);
+            ever_covered_.resize(id + 1, false);
+        }
+        if (!ever_covered_[id]) {
+            ever_covered_[id] = true;
+            covered_edges_ += 1;
         }
-        edge_coverage_[e]->insert(path);
+        edge_coverage_[id].insert(path);
     }
 
     void EdgeRemoved(EdgeId e, BidirectionalPath * path) {
-        auto iter = edge_coverage_.find(e);
-        if (iter != edge_coverage_.end()) {
-            if (iter->second->count(path) == 0) {
+        size_t id = g_.int_id(e);
+        if (id < edge_coverage_.size() && ever_covered_[id]) {
+            if (!edge_coverage_[id].erase(path)) {
                 DEBUG("Error erasing path from coverage map");
-            } else {
-                auto entry = iter->second->find(path);
-                iter->second->erase(entry);
             }
         }
     }
@@ -78,10 +121,10 @@ private:
         }
     }
 
-    size_t EdgeCount() const {
+    size_t EdgeIdBound() const {
         size_t result = 0;
         for (auto e = g_.ConstEdgeBegin(); !e.IsEnd(); ++e) {
-            ++result;
+            result = std::max(result, size_t(g_.int_id(*e)) + 1);
         }
         return result;
     }
@@ -92,9 +135,11 @@ public:
 
     GraphCoverageMap(GraphCoverageMap&&) = default;
 
-    explicit GraphCoverageMap(const Graph& g) : g_(g) {
+    explicit GraphCoverageMap(const Graph& g) : g_(g), covered_edges_(0) {
         //FIXME heavy constructor
-        edge_coverage_.reserve(EdgeCount());
+        size_t bound = EdgeIdBound();
+        edge_coverage_.resize(bound);
+        ever_covered_.resize(bound, false);
     }
 
     GraphCoverageMap(const Graph& g, const PathContainer& paths, bool subscribe = false) :
@@ -102,12 +147,6 @@ public:
         AddPaths(paths, subscribe);
     }
 
-    ~GraphCoverageMap() {
-        for (auto iter = edge_coverage_.begin(); iter != edge_coverage_.end(); ++iter) {
-            delete iter->second;
-        }
-    }
-
     void AddPaths(const PathContainer& paths, bool subscribe = false) {
         for (auto path_pair : paths) {
             ProcessPath(path_pair.first, subscribe);
@@ -140,9 +179,9 @@ public:
     }
 
     const MapDataT *  GetEdgePaths(EdgeId e) const {
-        auto iter = edge_coverage_.find(e);
-        if (iter != edge_coverage_.end()) {
-            return iter->second;
+        size_t id = g_.int_id(e);
+        if (id < edge_coverage_.size()) {
+            return &edge_coverage_[id];
         }
         return &empty_;
     }
@@ -164,21 +203,27 @@ public:
         return true;
     }
 
-    BidirectionalPathSet GetCoveringPaths(EdgeId e) const {
-        auto mapData = GetEdgePaths(e);
-        return BidirectionalPathSet(mapData->begin(), mapData->end());
+    //Number of times the path covers the edge.
+    //Paths set pending by the current thread (see SetPendingPaths()) are counted as if subscribed already.
+    size_t PathEdgeCount(BidirectionalPath *path, EdgeId e) const {
+        const auto *pending = PendingPaths::get();
+        if (pending && std::find(pending->begin(), pending->end(), path) != pending->end())
+            return path->FindAll(e).size();
+        return GetEdgePaths(e)->count(path);
     }
 
-    std::unordered_map <EdgeId, MapDataT * >::const_iterator begin() const {
-        return edge_coverage_.begin();
+    //Paths to be subscribed later, e.g. the ones grown speculatively by the current thread (or null)
+    static void SetPendingPaths(const std::vector<BidirectionalPath*> *paths) {
+        PendingPaths::set(paths);
     }
 
-    std::unordered_map <EdgeId, MapDataT * >::const_iterator end() const {
-        return edge_coverage_.end();
+    BidirectionalPathSet GetCoveringPaths(EdgeId e) const {
+        auto mapData = GetEdgePaths(e);
+        return BidirectionalPathSet(mapData->begin(), mapData->end());
     }
 
     size_t size() const {
-        return edge_coverage_.size();
+        return covered_edges_;
     }
 
     const Graph& graph() const {
@@ -284,7 +329,7 @@ inline size_t LoopDetector::LoopEdges(size_t skip_identical_edges, size_t min_cy
         return 0;
     }
     EdgeId e = path_->Back();
-    size_t count = cov_map_.GetEdgePaths(e)->count(path_);
+    size_t count = cov_map_.PathEdgeCount(path_, e);
     if (count <= 1 || count < min_cycle_appearences * (skip_identical_edges + 1)) {
         return 0;
     }
@@ -337,7 +382,7 @@ inline size_t LoopDetector::LastLoopCount(size_t edges) const {
 }
 
 inline bool LoopDetector::IsCycled(size_t loopLimit, size_t& skip_identical_edges) const {
-    if (path_->Size() == 0 or cov_map_.GetEdgePaths(path_->Back())->count(path_) < loopLimit) {
+    if (path_->Size() == 0 or cov_map_.PathEdgeCount(path_, path_->Back()) < loopLimit) {
         return false;
     }
     skip_identical_edges = 0;
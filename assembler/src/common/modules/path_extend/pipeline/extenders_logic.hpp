@@ -50,6 +50,7 @@ class ExtendersGenerator {
     UsedUniqueStorage &used_unique_storage_;
 
     const PELaunchSupport &support_;
+    FrozenPairedIndices &frozen_indices_;
 
 public:
     ExtendersGenerator(const config::dataset &dataset_info,
@@ -58,14 +59,16 @@ public:
                        const GraphCoverageMap &cover_map,
                        const UniqueData &unique_data,
                        UsedUniqueStorage &used_unique_storage,
-                       const PELaunchSupport& support) :
+                       const PELaunchSupport& support,
+                       FrozenPairedIndices &frozen_indices) :
         dataset_info_(dataset_info),
         params_(params),
         gp_(gp),
         cover_map_(cover_map),
         unique_data_(unique_data),
         used_unique_storage_(used_unique_storage),
-        support_(support) { }
+        support_(support),
+        frozen_indices_(frozen_indices) { }
 
     Extenders MakePBScaffoldingExtenders() const;
 
@@ -6,6 +6,7 @@
 
 
 #include "modules/path_extend/paired_library.hpp"
+#include "paired_info/frozen_paired_index.hpp"
 #include "pipeline/config_struct.hpp"
 #include "modules/path_extend/pe_config_struct.hpp"
 
@@ -97,6 +98,66 @@ struct PathExtendParamsContainer {
 };
 
 
+/*
+ * Read-optimized copies of the paired indices of the graph pack, made on the first request.
+ * Extenders query the indices much more often than anything else does.
+ */
+class FrozenPairedIndices {
+    typedef omnigraph::de::FrozenPairedInfoIndexT<Graph> FrozenIndex;
+    typedef omnigraph::de::FrozenUnclusteredPairedInfoIndexT<Graph> FrozenUnclusteredIndex;
+
+    conj_graph_pack &gp_;
+    bool release_originals_;
+    std::vector<std::unique_ptr<FrozenIndex>> clustered_;
+    std::vector<std::unique_ptr<FrozenIndex>> scaffolding_;
+    std::vector<std::unique_ptr<FrozenUnclusteredIndex>> paired_;
+
+    template<class Frozen, class Indices>
+    const Frozen &Freeze(std::vector<std::unique_ptr<Frozen>> &frozen,
+                         Indices &indices, size_t lib_index) {
+        frozen.resize(indices.size());
+        if (!frozen[lib_index]) {
+            frozen[lib_index].reset(new Frozen(indices[lib_index].graph()));
+            frozen[lib_index]->Build(indices[lib_index]);
+            if (release_originals_)
+                indices[lib_index].clear();
+        }
+        return *frozen[lib_index];
+    }
+
+    template<class Frozen, class Indices>
+    static void Release(const std::vector<std::unique_ptr<Frozen>> &frozen, Indices &indices) {
+        for (size_t i = 0; i < frozen.size(); ++i) {
+            if (frozen[i])
+                indices[i].clear();
+        }
+    }
+
+public:
+    explicit FrozenPairedIndices(conj_graph_pack &gp)
+            : gp_(gp), release_originals_(false) { }
+
+    const FrozenIndex &clustered(size_t lib_index) {
+        return Freeze(clustered_, gp_.clustered_indices, lib_index);
+    }
+
+    const FrozenIndex &scaffolding(size_t lib_index) {
+        return Freeze(scaffolding_, gp_.scaffolding_indices, lib_index);
+    }
+
+    const FrozenUnclusteredIndex &paired(size_t lib_index) {
+        return Freeze(paired_, gp_.paired_indices, lib_index);
+    }
+
+    // Clears the original indices frozen so far and the ones frozen later, the originals must not be read after that
+    void ReleaseOriginals() {
+        release_originals_ = true;
+        Release(clustered_, gp_.clustered_indices);
+        Release(scaffolding_, gp_.scaffolding_indices);
+        Release(paired_, gp_.paired_indices);
+    }
+};
+
 class PELaunchSupport {
     const config::dataset& dataset_info_;
     const PathExtendParamsContainer& params_;
@@ -405,7 +405,7 @@ Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_m
     if (!config::PipelineHelper::IsPlasmidPipeline(params_.mode) &&  (support_.SingleReadsMapped() || support_.HasLongReads()))
         FillLongReadsCoverageMaps();
     ExtendersGenerator generator(dataset_info_, params_, gp_, cover_map,
-                                 unique_data_, used_unique_storage, support_);
+                                 unique_data_, used_unique_storage, support_, frozen_indices_);
     Extenders extenders = generator.MakeBasicExtenders();
 
     //long reads scaffolding extenders.
@@ -434,7 +434,7 @@ Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_m
 }
 
 void PathExtendLauncher::PolishPaths(const PathContainer &paths, PathContainer &result,
-                                     const GraphCoverageMap& /* cover_map */) const {
+                                     const GraphCoverageMap& /* cover_map */) {
     //Fixes distances for paths gaps and tries to fill them in
     INFO("Closing gaps in paths");
 
@@ -444,7 +444,7 @@ void PathExtendLauncher::PolishPaths(const PathContainer &paths, PathContainer &
     for (size_t i = 0; i < dataset_info_.reads.lib_count(); i++) {
         auto lib = dataset_info_.reads[i];
         if (lib.type() == io::LibraryType::HQMatePairs || lib.type() == io::LibraryType::MatePairs) {
-            shared_ptr<PairedInfoLibrary> paired_lib = MakeNewLib(gp_.g, lib, gp_.paired_indices[i]);
+            shared_ptr<PairedInfoLibrary> paired_lib = MakeNewLib(gp_.g, lib, frozen_indices_.paired(i));
             gap_closers.push_back(make_shared<MatePairGapCloser> (gp_.g, params_.max_polisher_gap, paired_lib,
                                                                    unique_data_.main_unique_storage_));
         }
@@ -567,6 +567,10 @@ void PathExtendLauncher::Launch() {
                                          used_unique_storage,
                                          extenders);
 
+    //Metaplasmid pipeline resolves repeats again on the same indices, misassembly report reads the originals
+    if (params_.mode != config::pipeline_type::metaplasmid && gp_.genome.size() == 0)
+        frozen_indices_.ReleaseOriginals();
+
     auto paths = resolver.ExtendSeeds(seeds, composite_extender);
     DebugOutputPaths(paths, "raw_paths");
 
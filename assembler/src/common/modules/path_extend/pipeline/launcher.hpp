@@ -24,6 +24,7 @@ class PathExtendLauncher {
     const PathExtendParamsContainer& params_;
     conj_graph_pack& gp_;
     PELaunchSupport support_;
+    FrozenPairedIndices frozen_indices_;
 
     std::shared_ptr<ContigNameGenerator> contig_name_generator_;
     ContigWriter writer_;
@@ -67,7 +68,7 @@ class PathExtendLauncher {
 
     void TraverseLoops(PathContainer &paths, GraphCoverageMap &cover_map) const;
 
-    void PolishPaths(const PathContainer &paths, PathContainer &result, const GraphCoverageMap &cover_map) const;
+    void PolishPaths(const PathContainer &paths, PathContainer &result, const GraphCoverageMap &cover_map);
 
     Extenders ConstructExtenders(const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage);
 
@@ -92,6 +93,7 @@ public:
         params_(params),
         gp_(gp),
         support_(dataset_info, params),
+        frozen_indices_(gp),
         contig_name_generator_(MakeContigNameGenerator(params_.mode, gp)),
         writer_(gp.g, contig_name_generator_),
         unique_data_() {
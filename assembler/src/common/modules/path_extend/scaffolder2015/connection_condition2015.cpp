@@ -1,4 +1,5 @@
 #include "connection_condition2015.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 namespace path_extend {
 
@@ -226,19 +227,29 @@ AssemblyGraphConnectionCondition::AssemblyGraphConnectionCondition(const debruij
                                                                    size_t max_connection_length,
                                                                    const ScaffoldingUniqueEdgeStorage &unique_edges) :
         g_(g), max_connection_length_(max_connection_length),
-        interesting_edge_set_(unique_edges.unique_edges()), stored_distances_() {
+        interesting_edge_set_(unique_edges.unique_edges()), stored_distances_(omp_get_max_threads()) {
 }
 
 Connections AssemblyGraphConnectionCondition::ConnectedWith(debruijn_graph::EdgeId e) const {
     VERIFY_MSG(interesting_edge_set_.find(e) != interesting_edge_set_.end(),
                " edge "<< e.int_id() << " not applicable for connection condition");
-    if (stored_distances_.find(e) != stored_distances_.end()) {
-        return stored_distances_[e];
-    }
-    stored_distances_.emplace(e, Connections());
+    size_t thread = omp_get_thread_num();
+    //Threads beyond the ones there were at construction do not cache
+    if (thread >= stored_distances_.size())
+        return CountConnections(e);
+
+    auto &stored_distances = stored_distances_[thread];
+    auto it = stored_distances.find(e);
+    if (it == stored_distances.end())
+        it = stored_distances.emplace(e, CountConnections(e)).first;
+    return it->second;
+}
+
+Connections AssemblyGraphConnectionCondition::CountConnections(debruijn_graph::EdgeId e) const {
+    Connections result;
     for (auto connected: g_.OutgoingEdges(g_.EdgeEnd(e))) {
         if (interesting_edge_set_.find(connected) != interesting_edge_set_.end()) {
-            stored_distances_[e].emplace(connected, 1);
+            result.emplace(connected, 1);
         }
     }
     auto dijkstra = DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_, max_connection_length_);
@@ -246,12 +257,13 @@ Connections AssemblyGraphConnectionCondition::ConnectedWith(debruijn_graph::Edge
     for (auto v: dijkstra.ReachedVertices()) {
         for (auto connected: g_.OutgoingEdges(v)) {
             if (interesting_edge_set_.find(connected) != interesting_edge_set_.end() && dijkstra.GetDistance(v) < max_connection_length_) {
-                stored_distances_[e].emplace(connected, 1);
+                result.emplace(connected, 1);
             }
         }
     }
-    return stored_distances_[e];
+    return result;
 }
+
 void AssemblyGraphConnectionCondition::AddInterestingEdges(func::TypedPredicate<typename Graph::EdgeId> edge_condition) {
     for (auto e_iter = g_.ConstEdgeBegin(); !e_iter.IsEnd(); ++e_iter) {
         if (edge_condition(*e_iter))
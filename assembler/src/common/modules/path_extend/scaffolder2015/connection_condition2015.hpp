@@ -134,7 +134,10 @@ protected:
 //Maximal gap to the connection.
     size_t max_connection_length_;
     EdgeSet interesting_edge_set_;
-    mutable std::map<EdgeId, Connections> stored_distances_;
+    // Per-thread caches, indexed by omp_get_thread_num()
+    mutable std::vector<std::map<EdgeId, Connections>> stored_distances_;
+
+    Connections CountConnections(EdgeId e) const;
 public:
     AssemblyGraphConnectionCondition(const Graph &g, size_t max_connection_length,
                                      const ScaffoldingUniqueEdgeStorage &unique_edges);
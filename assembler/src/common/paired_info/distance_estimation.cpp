@@ -15,37 +15,55 @@ std::vector<size_t> GraphDistanceFinder::GetGraphDistancesLengths(EdgeId e1, Edg
 }
 
 void GraphDistanceFinder::FillGraphDistancesLengths(EdgeId e1, LengthMap &second_edges) const {
-    std::vector<size_t> path_lower_bounds;
-    size_t path_upper_bound = PairInfoPathLengthUpperBound(graph_.k(), insert_size_, delta_);
-    PathProcessor <Graph> paths_proc(graph_, graph_.EdgeEnd(e1), path_upper_bound);
+    GraphDistanceCache cache(*this);
+    FillGraphDistancesLengths(e1, second_edges, cache);
+}
 
+void GraphDistanceFinder::FillGraphDistancesLengths(EdgeId e1, LengthMap &second_edges,
+                                                    GraphDistanceCache &cache) const {
     for (auto &entry : second_edges) {
         EdgeId e2 = entry.first;
         size_t path_lower_bound = PairInfoPathLengthLowerBound(graph_.k(), graph_.length(e1),
                                                                graph_.length(e2), gap_, delta_);
 
-        TRACE("Bounds for paths are " << path_lower_bound << " " << path_upper_bound);
+        TRACE("Bounds for paths are " << path_lower_bound << " " << PathLengthUpperBound());
 
-        DistancesLengthsCallback<Graph> callback(graph_);
-        paths_proc.Process(graph_.EdgeStart(e2), path_lower_bound, path_upper_bound, callback);
-        GraphLengths lengths = callback.distances();
-        for (size_t j = 0; j < lengths.size(); ++j) {
-            lengths[j] += graph_.length(e1);
+        const GraphLengths &paths = cache.PathLengths(graph_.EdgeEnd(e1), graph_.EdgeStart(e2));
+        GraphLengths lengths;
+        if (e1 == e2)
+            lengths.push_back(0);
+        for (auto it = std::lower_bound(paths.begin(), paths.end(), path_lower_bound); it != paths.end(); ++it) {
+            lengths.push_back(*it + graph_.length(e1));
             TRACE("Resulting distance set for " <<
                                                 " edge " << graph_.int_id(e2) <<
-                                                " #" << j << " length " << lengths[j]);
+                                                " length " << lengths.back());
         }
 
-        if (e1 == e2)
-            lengths.push_back(0);
+        entry.second = std::move(lengths);
+    }
+}
 
-        std::sort(lengths.begin(), lengths.end());
-        entry.second = lengths;
+const GraphDistanceCache::GraphLengths &GraphDistanceCache::PathLengths(VertexId from, VertexId to) {
+    const Graph &g = finder_.graph();
+    size_t path_upper_bound = finder_.PathLengthUpperBound();
+    if (!processor_ || from != from_) {
+        processor_.reset(new PathProcessor<Graph>(g, from, path_upper_bound));
+        from_ = from;
+        lengths_.clear();
     }
+
+    auto it = lengths_.find(to);
+    if (it != lengths_.end())
+        return it->second;
+
+    DistancesLengthsCallback<Graph> callback(g);
+    processor_->Process(to, 0, path_upper_bound, callback);
+    return lengths_.emplace(to, callback.distances()).first->second;
 }
 
-void AbstractDistanceEstimator::FillGraphDistancesLengths(EdgeId e1, LengthMap &second_edges) const {
-    distance_finder_.FillGraphDistancesLengths(e1, second_edges);
+void AbstractDistanceEstimator::FillGraphDistancesLengths(EdgeId e1, LengthMap &second_edges,
+                                                          GraphDistanceCache &cache) const {
+    distance_finder_.FillGraphDistancesLengths(e1, second_edges, cache);
 }
 
 AbstractDistanceEstimator::OutHistogram AbstractDistanceEstimator::ClusterResult(EdgePair,
@@ -76,16 +94,34 @@ void DistanceEstimator::Estimate(PairedInfoIndexT<Graph> &result, size_t nthread
     const auto &index = this->index();
 
     DEBUG("Collecting edge infos");
+    const auto &g = this->graph();
     std::vector<EdgeId> edges;
-    for (auto it = this->graph().ConstEdgeBegin(); !it.IsEnd(); ++it)
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
         edges.push_back(*it);
 
-    DEBUG("Processing");
-    PairedInfoBuffersT<Graph> buffer(this->graph(), nthreads);
+    // Edges sharing an end vertex go to the same thread, so that the bounded
+    // path search from that vertex is done once per vertex, not once per edge
+    std::sort(edges.begin(), edges.end(), [&](EdgeId a, EdgeId b) {
+        return std::make_pair(g.EdgeEnd(a), a) < std::make_pair(g.EdgeEnd(b), b);
+    });
+    std::vector<size_t> groups;
+    for (size_t i = 0; i < edges.size(); ++i)
+        if (i == 0 || g.EdgeEnd(edges[i]) != g.EdgeEnd(edges[i - 1]))
+            groups.push_back(i);
+    size_t group_cnt = groups.size();
+    groups.push_back(edges.size());
+
+    DEBUG("Processing " << edges.size() << " edges ending in " << group_cnt << " vertices");
+    PairedInfoBuffersT<Graph> buffer(g, nthreads);
+    std::vector<GraphDistanceCache> caches;
+    caches.reserve(nthreads);
+    for (size_t i = 0; i < nthreads; ++i)
+        caches.emplace_back(this->distance_finder());
 #   pragma omp parallel for num_threads(nthreads) schedule(guided, 10)
-    for (size_t i = 0; i < edges.size(); ++i) {
-        EdgeId edge = edges[i];
-        ProcessEdge(edge, index, buffer[omp_get_thread_num()]);
+    for (size_t i = 0; i < group_cnt; ++i) {
+        size_t thread = omp_get_thread_num();
+        for (size_t j = groups[i]; j < groups[i + 1]; ++j)
+            ProcessEdge(edges[j], index, caches[thread], buffer[thread]);
     }
 
     for (size_t i = 0; i < nthreads; ++i) {
@@ -149,13 +185,14 @@ DistanceEstimator::EstimHist DistanceEstimator::EstimateEdgePairDistances(EdgePa
     return result;
 }
 
-void DistanceEstimator::ProcessEdge(EdgeId e1, const InPairedIndex &pi, PairedInfoBuffer<Graph> &result) const {
+void DistanceEstimator::ProcessEdge(EdgeId e1, const InPairedIndex &pi, GraphDistanceCache &cache,
+                                    PairedInfoBuffer<Graph> &result) const {
     typename base::LengthMap second_edges;
     auto inner_map = pi.GetHalf(e1);
     for (auto i : inner_map)
         second_edges[i.first];
 
-    this->FillGraphDistancesLengths(e1, second_edges);
+    this->FillGraphDistancesLengths(e1, second_edges, cache);
 
     for (const auto &entry: second_edges) {
         EdgeId e2 = entry.first;
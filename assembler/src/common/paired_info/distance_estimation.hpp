@@ -17,10 +17,15 @@
 #include "paired_info.hpp"
 #include "math/xmath.h"
 
+#include <memory>
+#include <unordered_map>
+
 namespace omnigraph {
 
 namespace de {
 
+class GraphDistanceCache;
+
 //todo move to some more common place
 class GraphDistanceFinder {
     typedef std::vector<debruijn_graph::EdgeId> Path;
@@ -37,6 +42,16 @@ public:
     // finds all distances from a current edge to a set of edges
     void FillGraphDistancesLengths(debruijn_graph::EdgeId e1, LengthMap &second_edges) const;
 
+    // same as above, but reuses path lengths already collected by the cache
+    void FillGraphDistancesLengths(debruijn_graph::EdgeId e1, LengthMap &second_edges,
+                                   GraphDistanceCache &cache) const;
+
+    const debruijn_graph::Graph &graph() const { return graph_; }
+
+    size_t PathLengthUpperBound() const {
+        return PairInfoPathLengthUpperBound(graph_.k(), insert_size_, delta_);
+    }
+
 private:
     DECL_LOGGER("GraphDistanceFinder");
     const debruijn_graph::Graph &graph_;
@@ -45,6 +60,34 @@ private:
     const double delta_;
 };
 
+/**
+ * @brief Per-thread memo of bounded path lengths used by the distance estimators.
+ *
+ * The path search space only depends on the start vertex, so the Dijkstra run
+ * from the end of e1 is shared by all edges ending in the same vertex, and the
+ * lengths of paths to a vertex are shared by all paired edges starting there.
+ * Lengths are kept for a single start vertex: switching to another one drops them.
+ */
+class GraphDistanceCache {
+    typedef std::vector<size_t> GraphLengths;
+    typedef debruijn_graph::VertexId VertexId;
+
+public:
+    explicit GraphDistanceCache(const GraphDistanceFinder &finder)
+            : finder_(finder), from_() { }
+
+    // sorted lengths of all paths from 'from' to 'to' within the finder upper bound
+    const GraphLengths &PathLengths(VertexId from, VertexId to);
+
+private:
+    const GraphDistanceFinder &finder_;
+    VertexId from_;
+    std::unique_ptr<PathProcessor<debruijn_graph::Graph>> processor_;
+    std::unordered_map<VertexId, GraphLengths> lengths_;
+
+    DECL_LOGGER("GraphDistanceCache");
+};
+
 class AbstractDistanceEstimator {
 protected:
     typedef UnclusteredPairedInfoIndexT<debruijn_graph::Graph> InPairedIndex;
@@ -74,7 +117,10 @@ protected:
 
     const InPairedIndex &index() const { return index_; }
 
-    void FillGraphDistancesLengths(debruijn_graph::EdgeId e1, LengthMap &second_edges) const;
+    void FillGraphDistancesLengths(debruijn_graph::EdgeId e1, LengthMap &second_edges,
+                                   GraphDistanceCache &cache) const;
+
+    const GraphDistanceFinder &distance_finder() const { return distance_finder_; }
 
     OutHistogram ClusterResult(EdgePair /*ep*/, const EstimHist &estimated) const;
 
@@ -128,6 +174,7 @@ protected:
 private:
     virtual void ProcessEdge(debruijn_graph::EdgeId e1,
                              const InPairedIndex &pi,
+                             GraphDistanceCache &cache,
                              PairedInfoBuffer<debruijn_graph::Graph> &result) const;
 
     virtual const std::string Name() const {
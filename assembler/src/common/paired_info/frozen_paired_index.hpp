@@ -0,0 +1,508 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "paired_info.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace omnigraph {
+
+namespace de {
+
+/**
+ * @brief Read-only paired index with a flat (CSR-like) layout, made of a PairedIndex or a concurrent buffer.
+ * @detail All points are kept in a single array, the histogram of an edge pair being a range in it
+ *         (the conjugate pair refers to the same range). For each first edge the second edges with
+ *         their ranges are kept sorted in a single array as well, and the run of the first edge is
+ *         looked up by its id. Thus getting a histogram takes a binary search in a single run.
+ *         Provides the same data accessing methods as PairedIndex.
+ * @param G graph type
+ * @param Traits Policy-like structure with associated types of inner and resulting points
+ */
+template<typename G, typename Traits>
+class FrozenPairedIndex {
+    typedef typename Traits::Gapped InnerPoint;
+
+public:
+    typedef G Graph;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef std::pair<EdgeId, EdgeId> EdgePair;
+    typedef typename Traits::Expanded Point;
+
+    typedef omnigraph::de::Histogram<Point> Histogram;
+
+private:
+    //Second edge of a pair with the range of its points
+    struct Entry {
+        EdgeId e2;
+        size_t begin, end;
+
+        bool operator<(const Entry &other) const {
+            return e2 < other.e2;
+        }
+    };
+
+    //Neighbourhood of a first edge in the index being frozen
+    template<class InnerMap>
+    struct Row {
+        size_t id;
+        EdgeId e1;
+        const InnerMap *map;
+    };
+
+    static const size_t UNSET = size_t(-1);
+
+public:
+    //---------------- Data accessing methods ----------------
+
+    /**
+     * @brief Proxy set of points between two edges, see PairedIndex::HistProxy.
+     */
+    class HistProxy {
+
+    public:
+        /**
+         * @brief Iterator over a proxy set of points.
+         */
+        class Iterator: public boost::iterator_facade<Iterator, Point, boost::bidirectional_traversal_tag, Point> {
+
+            typedef const InnerPoint *InnerIterator;
+
+        public:
+            Iterator(InnerIterator iter, DEDistance offset)
+                    : iter_(iter), offset_(offset)
+            {}
+
+        private:
+            friend class boost::iterator_core_access;
+
+            Point dereference() const {
+                return Traits::Expand(*iter_, offset_);
+            }
+
+            void increment() {
+                ++iter_;
+            }
+
+            void decrement() {
+                --iter_;
+            }
+
+            inline bool equal(const Iterator &other) const {
+                return iter_ == other.iter_;
+            }
+
+            InnerIterator iter_; //current position
+            DEDistance offset_; //edge length
+        };
+
+        HistProxy(const InnerPoint *begin, const InnerPoint *end, DEDistance offset = 0)
+            : begin_(begin), end_(end), offset_(offset)
+        {}
+
+        /**
+         * @brief Returns an empty proxy (effectively a Null object pattern).
+         */
+        static HistProxy empty_hist() {
+            return HistProxy(nullptr, nullptr);
+        }
+
+        Iterator begin() const {
+            return Iterator(begin_, offset_);
+        }
+
+        Iterator end() const {
+            return Iterator(end_, offset_);
+        }
+
+        /**
+         * @brief Finds the point with the minimal distance.
+         */
+        Point min() const {
+            VERIFY(!empty());
+            return *begin();
+        }
+
+        /**
+         * @brief Finds the point with the maximal distance.
+         */
+        Point max() const {
+            VERIFY(!empty());
+            return *--end();
+        }
+
+        /**
+         * @brief Returns the copy of all points in a simple flat histogram.
+         */
+        Histogram Unwrap() const {
+            return Histogram(begin(), end());
+        }
+
+        size_t size() const {
+            return end_ - begin_;
+        }
+
+        bool empty() const {
+            return begin_ == end_;
+        }
+
+    private:
+        const InnerPoint *begin_, *end_;
+        DEDistance offset_;
+    };
+
+    typedef typename HistProxy::Iterator HistIterator;
+
+    //---- Traversing edge neighbours ----
+
+    using EdgeHist = std::pair<EdgeId, HistProxy>;
+
+    /**
+     * @brief Proxy map representing neighbourhood of an edge, see PairedIndex::EdgeProxy.
+     */
+    class EdgeProxy {
+    public:
+
+        /**
+         * @brief Iterator over a proxy map.
+         * @detail For a full proxy, traverses both straight and conjugate pairs.
+         *         For a half proxy, traverses only lesser pairs (i.e., (a,b) where (a,b)<=(b',a')) of edges.
+         */
+        class Iterator: public boost::iterator_facade<Iterator, EdgeHist, boost::forward_traversal_tag, EdgeHist> {
+
+            typedef const Entry *InnerIterator;
+
+            void Skip() { //For a half iterator, skip conjugate pairs
+                while (half_ && iter_ != stop_ && !index_->IsCanonical(edge_, iter_->e2))
+                    ++iter_;
+            }
+
+        public:
+            Iterator(const FrozenPairedIndex &index, InnerIterator iter, InnerIterator stop, EdgeId edge, bool half)
+                    : index_(&index)
+                    , iter_(iter)
+                    , stop_(stop)
+                    , edge_(edge)
+                    , half_(half)
+            {
+                Skip();
+            }
+
+            void increment() {
+                ++iter_;
+                Skip();
+            }
+
+        private:
+            friend class boost::iterator_core_access;
+
+            bool equal(const Iterator &other) const {
+                return iter_ == other.iter_;
+            }
+
+            EdgeHist dereference() const {
+                return std::make_pair(iter_->e2, index_->MakeProxy(edge_, *iter_));
+            }
+
+        private:
+            const FrozenPairedIndex *index_;
+            InnerIterator iter_, stop_;
+            EdgeId edge_;
+            bool half_;
+        };
+
+        EdgeProxy(const FrozenPairedIndex &index, const Entry *begin, const Entry *end, EdgeId edge, bool half = false)
+            : index_(index), begin_(begin), end_(end), edge_(edge), half_(half)
+        {}
+
+        Iterator begin() const {
+            return Iterator(index_, begin_, end_, edge_, half_);
+        }
+
+        Iterator end() const {
+            return Iterator(index_, end_, end_, edge_, half_);
+        }
+
+        HistProxy operator[](EdgeId e2) const {
+            if (half_ && !index_.IsCanonical(edge_, e2))
+                return HistProxy::empty_hist();
+            return index_.Get(edge_, e2);
+        }
+
+        bool empty() const {
+            return begin_ == end_;
+        }
+
+    private:
+        const FrozenPairedIndex &index_;
+        const Entry *begin_, *end_;
+        EdgeId edge_;
+        //When false, represents all neighbours (consisting both of directly added data and "restored" conjugates).
+        //When true, proxifies only half of the added edges.
+        bool half_;
+    };
+
+    typedef typename EdgeProxy::Iterator EdgeIterator;
+
+    //---------------- Constructor ----------------
+
+    FrozenPairedIndex(const Graph &graph)
+        : size_(0), graph_(graph) {
+        clear();
+    }
+
+    /**
+     * @brief Makes the index of all the info of a PairedIndex with the same points.
+     *        The runs of the edges are filled in parallel.
+     */
+    template<template<typename, typename> class Container>
+    void Build(const PairedIndex<G, Traits, Container> &index) {
+        BuildFrom(index.data_begin(), index.data_end());
+        size_ = index.size();
+    }
+
+    /**
+     * @brief Makes the index of all the info of a (concurrent) buffer with the same points.
+     *        The runs of the edges are filled in parallel.
+     */
+    template<class Buffer>
+    void Build(Buffer &buffer) {
+        auto locked_table = buffer.lock_table();
+        BuildFrom(locked_table.begin(), locked_table.end());
+        size_ = buffer.size();
+    }
+
+    /**
+     * @brief Clears the whole index.
+     */
+    void clear() {
+        offsets_.assign(1, 0);
+        entries_.clear();
+        points_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief Returns a whole proxy map to the neighbourhood of some edge.
+     * @param e ID of starting edge
+     */
+    EdgeProxy Get(EdgeId e) const {
+        auto row = GetRow(e);
+        return EdgeProxy(*this, row.first, row.second, e);
+    }
+
+    /**
+     * @brief Returns a half proxy map to the neighbourhood of some edge.
+     * @param e ID of starting edge
+     */
+    EdgeProxy GetHalf(EdgeId e) const {
+        auto row = GetRow(e);
+        return EdgeProxy(*this, row.first, row.second, e, true);
+    }
+
+    /**
+     * @brief Operator alias of Get(id).
+     */
+    EdgeProxy operator[](EdgeId e) const {
+        return Get(e);
+    }
+
+    /**
+     * @brief Returns a histogram proxy for all points between two edges.
+     */
+    HistProxy Get(EdgeId e1, EdgeId e2) const {
+        const Entry *entry = Find(e1, e2);
+        if (!entry)
+            return HistProxy::empty_hist();
+        return MakeProxy(e1, *entry);
+    }
+
+    /**
+     * @brief Operator alias of Get(e1, e2).
+     */
+    HistProxy operator[](EdgePair p) const {
+        return Get(p.first, p.second);
+    }
+
+    /**
+     * @brief Checks if an edge (or its conjugated twin) is consisted in the index.
+     */
+    bool contains(EdgeId edge) const {
+        auto row = GetRow(edge), conj_row = GetRow(graph_.conjugate(edge));
+        return row.first != row.second || conj_row.first != conj_row.second;
+    }
+
+    /**
+     * @brief Checks if there is a histogram for two points (or their conjugated pair).
+     */
+    bool contains(EdgeId e1, EdgeId e2) const {
+        return Find(e1, e2) != nullptr;
+    }
+
+    //---------------- Miscellaneous ----------------
+
+    /**
+     * Returns the graph the index is based on. Needed for custom iterators.
+     */
+    const Graph &graph() const { return graph_; }
+
+    /**
+     * @brief Returns the physical index size (total count of all histograms).
+     */
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Returns a conjugate pair for two edges.
+     */
+    EdgePair ConjugatePair(EdgeId e1, EdgeId e2) const {
+        return std::make_pair(graph_.conjugate(e2), graph_.conjugate(e1));
+    }
+
+    /**
+     * @brief Checks if an edge pair is canonical (less than its conjugate).
+     */
+    bool IsCanonical(EdgeId e1, EdgeId e2) const {
+        auto ep = std::make_pair(e1, e2);
+        return ep <= ConjugatePair(e1, e2);
+    }
+
+    void BinWrite(std::ostream &str) const {
+        using io::binary::BinWrite;
+        BinWrite(str, size_, offsets_.size(), entries_.size(), points_.size());
+        for (size_t offset : offsets_)
+            BinWrite(str, offset);
+        for (const auto &entry : entries_)
+            BinWrite(str, uint64_t(graph_.int_id(entry.e2)), entry.begin, entry.end);
+        str.write(reinterpret_cast<const char *>(points_.data()), points_.size() * sizeof(InnerPoint));
+    }
+
+    void BinRead(std::istream &str) {
+        clear();
+        using io::binary::BinRead;
+        auto size = BinRead<size_t>(str);
+        offsets_.resize(BinRead<size_t>(str));
+        entries_.resize(BinRead<size_t>(str));
+        points_.resize(BinRead<size_t>(str));
+        for (size_t &offset : offsets_)
+            BinRead(str, offset);
+        for (auto &entry : entries_) {
+            entry.e2 = BinRead<uint64_t>(str);
+            BinRead(str, entry.begin, entry.end);
+        }
+        str.read(reinterpret_cast<char *>(points_.data()), points_.size() * sizeof(InnerPoint));
+        size_ = size;
+    }
+
+private:
+    HistProxy MakeProxy(EdgeId e1, const Entry &entry) const {
+        return HistProxy(points_.data() + entry.begin, points_.data() + entry.end, DEDistance(graph_.length(e1)));
+    }
+
+    std::pair<const Entry*, const Entry*> GetRow(EdgeId e) const {
+        size_t id = graph_.int_id(e);
+        if (id + 1 >= offsets_.size())
+            return { nullptr, nullptr };
+        return { entries_.data() + offsets_[id], entries_.data() + offsets_[id + 1] };
+    }
+
+    //When there is no such histogram, returns null
+    const Entry *Find(EdgeId e1, EdgeId e2) const {
+        auto row = GetRow(e1);
+        Entry key;
+        key.e2 = e2;
+        auto entry = std::lower_bound(row.first, row.second, key);
+        if (entry == row.second || entry->e2 != e2)
+            return nullptr;
+        return entry;
+    }
+
+    template<class Iterator>
+    void BuildFrom(Iterator begin, Iterator end) {
+        typedef typename std::decay<decltype((*begin).second)>::type InnerMap;
+        clear();
+        std::vector<Row<InnerMap>> rows;
+        for (auto it = begin; it != end; ++it)
+            rows.push_back({ graph_.int_id((*it).first), (*it).first, &(*it).second });
+
+        std::sort(rows.begin(), rows.end(), [](const Row<InnerMap> &a, const Row<InnerMap> &b) {
+            return a.id < b.id;
+        });
+        if (rows.empty())
+            return;
+
+        //Offsets of the owned histograms of the runs in the points
+        std::vector<size_t> point_offsets(rows.size() + 1, 0);
+        offsets_.assign(rows.back().id + 2, 0);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            size_t owned = 0;
+            for (const auto &j : *rows[i].map) {
+                if (j.second.owning())
+                    owned += j.second->size();
+            }
+            offsets_[rows[i].id + 1] = rows[i].map->size();
+            point_offsets[i + 1] = point_offsets[i] + owned;
+        }
+        for (size_t i = 1; i < offsets_.size(); ++i)
+            offsets_[i] += offsets_[i - 1];
+        entries_.resize(offsets_.back());
+        points_.resize(point_offsets.back());
+
+        //First, the owned histograms are copied, the conjugate views are left unset
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < rows.size(); ++i) {
+            Entry *run = entries_.data() + offsets_[rows[i].id], *entry = run;
+            size_t pos = point_offsets[i];
+            for (const auto &j : *rows[i].map) {
+                entry->e2 = j.first;
+                entry->begin = entry->end = UNSET;
+                if (j.second.owning()) {
+                    entry->begin = pos;
+                    std::copy(j.second->begin(), j.second->end(), points_.begin() + pos);
+                    pos += j.second->size();
+                    entry->end = pos;
+                }
+                ++entry;
+            }
+            std::sort(run, entry);
+        }
+
+        //Then, the views are pointed to the histograms of the conjugate pairs
+        #pragma omp parallel for schedule(guided)
+        for (size_t i = 0; i < rows.size(); ++i) {
+            Entry *run = entries_.data() + offsets_[rows[i].id];
+            for (Entry *entry = run; entry != entries_.data() + offsets_[rows[i].id + 1]; ++entry) {
+                if (entry->begin != UNSET)
+                    continue;
+                auto conj = ConjugatePair(rows[i].e1, entry->e2);
+                const Entry *owner = Find(conj.first, conj.second);
+                VERIFY_MSG(owner && owner->begin != UNSET, "Index insertion inconsistency");
+                entry->begin = owner->begin;
+                entry->end = owner->end;
+            }
+        }
+    }
+
+    std::vector<size_t> offsets_;
+    std::vector<Entry> entries_;
+    std::vector<InnerPoint> points_;
+    size_t size_;
+    const Graph &graph_;
+};
+
+template<typename Graph>
+using FrozenPairedInfoIndexT = FrozenPairedIndex<Graph, PointTraits>;
+
+template<typename Graph>
+using FrozenUnclusteredPairedInfoIndexT = FrozenPairedIndex<Graph, RawPointTraits>;
+
+}
+
+}
@@ -46,12 +46,12 @@ class ParallelEdgeProcessor {
 
 public:
     ParallelEdgeProcessor(const Graph &g, unsigned nthreads)
-            : rp_(nthreads), it_(g) {}
+            : rp_(nthreads, /* batch_size */ 16), it_(g) {}
 
     template <class Processor>
     bool Run(Processor &op) { return rp_.Run(it_, op); }
 
-    bool IsEnd() const { return it_.eof(); }
+    bool IsEnd() const { return it_.eof() && !rp_.pending(); }
     size_t processed() const { return rp_.processed(); }
 
 private:
@@ -110,11 +110,11 @@ class PairInfoImprover {
                                omnigraph::de::PairedInfoIndexT<Graph>& index, size_t max_repeat_length)
                 : to_remove_(to_remove), graph_(g), index_(index), max_repeat_length_(max_repeat_length) {}
 
-        bool operator()(std::unique_ptr<EdgeId> e) {
+        bool operator()(const EdgeId &e) {
             omnigraph::de::PairedInfoIndexT<Graph> &to_remove = to_remove_[omp_get_thread_num()];
 
-            if (graph_.length(*e)>= max_repeat_length_ && index_.contains(*e))
-                FindInconsistent(*e, to_remove);
+            if (graph_.length(e)>= max_repeat_length_ && index_.contains(e))
+                FindInconsistent(e, to_remove);
 
             return false;
         }
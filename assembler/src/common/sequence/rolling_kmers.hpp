@@ -0,0 +1,129 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "nucl.hpp"
+#include "utils/verify.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RollingKMerIterator
+ * @section DESCRIPTION
+ *
+ * Iterates over all k-mers of a sequence keeping both the k-mer and its reverse
+ * complement up to date. Every step is a couple of word shifts over the packed
+ * 2-bit data, the orientation of the canonical k-mer is determined by a
+ * word-wise comparison instead of the per-nucleotide loop of IsMinimal().
+ *
+ * Works for any k-mer type with the packed layout of Seq / RuntimeSeq
+ * (nucleotide i is stored in bits 2*(i % TNucl) of the word i / TNucl).
+ */
+template<class KMer>
+class RollingKMerIterator {
+    typedef typename KMer::DataType T;
+    static const size_t TBits = sizeof(T) << 3;
+    static const size_t TNucl = TBits >> 1;
+    static const size_t DataSize = KMer::DataSize;
+
+  public:
+    template<class S>
+    RollingKMerIterator(const S &seq, unsigned K, size_t from = 0)
+            : K_(K), size_(KMer::GetDataSize(K)),
+              last_shift_(T(((K - 1) & (TNucl - 1)) << 1)),
+              last_mask_(T(T(-1) >> (TBits - (last_shift_ + 2)))),
+              pos_(from), end_(seq.size()) {
+        VERIFY(size_ <= DataSize);
+        fwd_.fill(0);
+        rc_.fill(0);
+        if (pos_ + K_ > end_)
+            return;
+
+        for (size_t i = 0; i < K_; ++i) {
+            T c = T(dignucl_or_value(seq[pos_ + i]));
+            fwd_[i / TNucl] |= T(c << ((i & (TNucl - 1)) << 1));
+            size_t j = K_ - 1 - i;
+            rc_[j / TNucl] |= T(T(3 - c) << ((j & (TNucl - 1)) << 1));
+        }
+    }
+
+    bool good() const { return pos_ + K_ <= end_; }
+
+    // Position of the current k-mer in the sequence
+    size_t pos() const { return pos_; }
+
+    // Moves to the next k-mer, c is the nucleotide next to the current one
+    void shift(char c) {
+        T n = T(dignucl_or_value(c));
+
+        for (size_t i = 0; i + 1 < size_; ++i)
+            fwd_[i] = T((fwd_[i] >> 2) | T(fwd_[i + 1] << (TBits - 2)));
+        fwd_[size_ - 1] = T((fwd_[size_ - 1] >> 2) | T(n << last_shift_));
+
+        for (size_t i = size_ - 1; i > 0; --i)
+            rc_[i] = T((rc_[i] << 2) | (rc_[i - 1] >> (TBits - 2)));
+        rc_[0] = T((rc_[0] << 2) | T(3 - n));
+        rc_[size_ - 1] &= last_mask_;
+
+        pos_ += 1;
+    }
+
+    template<class S>
+    void next(const S &seq) {
+        if (pos_ + K_ < end_)
+            shift(seq[pos_ + K_]);
+        else
+            pos_ += 1;
+    }
+
+    // Same as kmer().IsMinimal()
+    bool is_minimal() const {
+        for (size_t i = 0; i < size_; ++i) {
+            T diff = fwd_[i] ^ rc_[i];
+            if (!diff)
+                continue;
+
+            unsigned bit = unsigned(__builtin_ctzll((unsigned long long)diff) & ~1u);
+            return ((fwd_[i] >> bit) & 3) < ((rc_[i] >> bit) & 3);
+        }
+
+        return true;
+    }
+
+    const T *fwd_data() const { return fwd_.data(); }
+    const T *rc_data() const { return rc_.data(); }
+    const T *canonical_data() const { return is_minimal() ? fwd_data() : rc_data(); }
+
+    KMer kmer() const { return KMer(K_, fwd_.data()); }
+    KMer rc() const { return KMer(K_, rc_.data()); }
+    KMer canonical() const { return KMer(K_, canonical_data()); }
+
+    // Hash of the k-mer as computed by KMer::hash
+    size_t hash(uint64_t seed = 0) const {
+        return KMer::GetHash(fwd_.data(), size_, seed);
+    }
+
+    size_t canonical_hash(uint64_t seed = 0) const {
+        return KMer::GetHash(canonical_data(), size_, seed);
+    }
+
+  private:
+    static char dignucl_or_value(char c) {
+        return is_nucl(c) ? dignucl(c) : c;
+    }
+
+    unsigned K_;
+    size_t size_;
+    T last_shift_;
+    T last_mask_;
+    size_t pos_;
+    size_t end_;
+    std::array<T, DataSize> fwd_;
+    std::array<T, DataSize> rc_;
+};
@@ -284,6 +284,9 @@ public:
 
 public:
     inline bool BinRead(std::istream &file);
+    // Same as above, but from the in-memory data [data, end). Returns the
+    // pointer past the record or nullptr if the record is truncated.
+    inline const char *BinRead(const char *data, const char *end);
     inline bool BinWrite(std::ostream &file) const;
 };
 
@@ -420,6 +423,26 @@ bool Sequence::BinRead(std::istream &file) {
     return !file.fail();
 }
 
+const char *Sequence::BinRead(const char *data, const char *end) {
+    if (size_t(end - data) < sizeof(size_))
+        return nullptr;
+    size_t size;
+    memcpy(&size, data, sizeof(size));
+    data += sizeof(size);
+
+    size_t bytes = DataSize(size) * sizeof(ST);
+    if (size_t(end - data) < bytes)
+        return nullptr;
+
+    size_ = size;
+    from_ = 0;
+    rtl_ = false;
+    data_ = llvm::IntrusiveRefCntPtr<ManagedNuclBuffer>(ManagedNuclBuffer::create(size_));
+    memcpy(data_->data(), data, bytes);
+
+    return data + bytes;
+}
+
 
 bool Sequence::BinWrite(std::ostream &file) const {
     if (from_ != 0 || rtl_) {
@@ -33,6 +33,7 @@ struct ConstructionStorage {
     std::unique_ptr<qf::cqf> cqf;
     std::unique_ptr<utils::KMerDiskCounter<RtSeq>> counter;
     std::unique_ptr<CoverageMap> coverage_map;
+    size_t kmers_estimate = 0;
     config::debruijn_config::construction params;
     io::ReadStreamList<io::SingleReadSeq> read_streams;
     io::ReadStreamList<io::SingleReadSeq> contigs_streams;
@@ -184,6 +185,7 @@ class CoverageFilter: public Construction::Phase {
 
         INFO("Estimating k-mers cardinality");
         size_t kmers = EstimateCardinalityUpperBound(kplusone, read_streams, hasher, KmerFilter());
+        storage().kmers_estimate = kmers;
 
         // Create main CQF using # of slots derived from estimated # of k-mers
         storage().cqf.reset(new qf::cqf(kmers));
@@ -234,7 +236,8 @@ public:
         utils::DeBruijnReadKMerSplitter<io::SingleReadSeq,
                                         utils::StoringTypeFilter<storing_type>>
                 splitter(storage().workdir, index.k() + 1, 0, merge_streams, buffer_size);
-        storage().counter.reset(new utils::KMerDiskCounter<RtSeq>(storage().workdir, splitter));
+        storage().counter.reset(new utils::KMerMemoryCounter<RtSeq>(storage().workdir, splitter,
+                                                                    storage().kmers_estimate));
         storage().counter->CountAll(nthreads, nthreads, /* merge */false);
     }
 
@@ -137,10 +137,10 @@ class HllFiller {
 
     //Return value: should we interrupt reads processing
     template <class Read>
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
         unsigned thread_id = (unsigned)omp_get_thread_num();
         reads[thread_id] += 1;
-        const Sequence &seq = r->sequence();
+        const Sequence &seq = r.sequence();
         if (seq.size() < k) {
             return false;
         }
@@ -174,8 +174,8 @@ size_t EstimateCardinalityForOneStream(unsigned k, ReadStream &streams, const Ha
     HllFiller<Hasher, KMerFilter> hll_filler(hlls, hasher, filter, k);
 
     for (size_t i = 0; i < streams.size(); ++i) {
-        while (!streams[i].eof()) {
-            hammer::ReadProcessor rp(nthreads);
+        hammer::ReadProcessor rp(nthreads);
+        while (!streams[i].eof() || rp.pending()) {
             rp.Run(streams[i], hll_filler);
 
             reads = hll_filler.processed_reads();
@@ -0,0 +1,104 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "adt/kmer_vector.hpp"
+#include "utils/verify.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <cstring>
+
+namespace utils {
+
+// In-memory storage for raw k-mer runs produced by the splitters. Every bucket
+// holds the sorted runs as a single contiguous k-mer vector plus the sizes of
+// the individual runs. The total amount of memory is bounded; once a bucket
+// does not fit into the budget it is marked as spilled and all its subsequent
+// runs go to the on-disk file instead. The budget is shared with the splitter,
+// which charges its own buffers before any run is appended.
+//
+// Different buckets could be appended concurrently, the same bucket must not.
+template<class Seq>
+class KMerMemoryBuckets {
+    typedef typename Seq::DataType ElTy;
+    typedef adt::KMerVector<Seq> Storage;
+
+  public:
+    typedef typename Storage::iterator iterator;
+
+    KMerMemoryBuckets(unsigned K, size_t num_buckets, size_t limit)
+            : K_(K), limit_(limit), used_(0),
+              runs_(num_buckets), reserved_(num_buckets, 0), spilled_(num_buckets, 0) {
+        data_.reserve(num_buckets);
+        for (size_t i = 0; i < num_buckets; ++i)
+            data_.emplace_back(K_, 0);
+    }
+
+    // Returns false if the run should be written to disk instead
+    bool append(size_t idx, const ElTy *data, size_t cnt) {
+        if (spilled_[idx])
+            return false;
+
+        Storage &bucket = data_[idx];
+        size_t need = bucket.size() + cnt;
+        if (need > bucket.capacity()) {
+            // Both the old and the new storage are alive while the bucket
+            // is being reallocated, so the whole new one is charged first
+            size_t capacity = std::max(need, 2 * bucket.capacity());
+            size_t new_bytes = capacity * bucket.el_data_size();
+            if (used_.fetch_add(new_bytes) + new_bytes > limit_) {
+                used_ -= new_bytes;
+                spilled_[idx] = 1;
+                return false;
+            }
+
+            bucket.reserve(capacity);
+            used_ -= reserved_[idx];
+            reserved_[idx] = new_bytes;
+        }
+
+        for (size_t i = 0; i < cnt; ++i)
+            bucket.push_back(data + i * bucket.el_size());
+        runs_[idx].push_back(cnt);
+
+        return true;
+    }
+
+    // Accounts memory used outside of the buckets, e.g. by the splitter buffers
+    void charge(size_t bytes) { used_ += bytes; }
+    void uncharge(size_t bytes) { used_ -= bytes; }
+
+    size_t size() const { return data_.size(); }
+    bool spilled(size_t idx) const { return spilled_[idx]; }
+    const std::vector<size_t> &runs(size_t idx) const { return runs_[idx]; }
+    size_t used() const { return used_; }
+    size_t limit() const { return limit_; }
+
+    iterator begin(size_t idx) { return data_[idx].begin(); }
+    iterator end(size_t idx) { return data_[idx].end(); }
+
+    void release(size_t idx) {
+        used_ -= reserved_[idx];
+        reserved_[idx] = 0;
+        data_[idx].clear();
+        data_[idx].shrink_to_fit();
+        runs_[idx].clear();
+    }
+
+  private:
+    unsigned K_;
+    size_t limit_;
+    std::atomic<size_t> used_;
+    std::vector<Storage> data_;
+    std::vector<std::vector<size_t>> runs_;
+    std::vector<size_t> reserved_;
+    std::vector<uint8_t> spilled_;
+};
+
+}
@@ -43,6 +43,7 @@
 #include <cmath>
 
 #include "kmer_splitters.hpp"
+#include "kmer_run_merger.hpp"
 
 namespace utils {
 
@@ -118,28 +119,19 @@ public:
     auto raw_kmers = splitter_.Split(num_files, num_threads);
 
     INFO("Starting k-mer counting.");
-    size_t kmers = 0;
-#   pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
-    for (unsigned i = 0; i < raw_kmers.size(); ++i) {
-      kmers += MergeKMers(*raw_kmers[i], GetUniqueKMersFname(i));
-      raw_kmers[i].reset();
-    }
+    KMerRunMerger<Seq> merger(k_);
+    std::vector<typename KMerRunMerger<Seq>::RunSet> runs(raw_kmers.size());
+    for (unsigned i = 0; i < raw_kmers.size(); ++i)
+      merger.LoadRuns(*raw_kmers[i], runs[i]);
+
+    size_t kmers = merger.Merge(runs, MergedKMersFnames(), num_threads);
+    raw_kmers.clear();
     INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
     if (!kmers) {
       FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
       exit(-1);
     }
 
-    INFO("Merging temporary buckets.");
-    for (unsigned i = 0; i < num_buckets; ++i) {
-      std::string ofname = GetMergedKMersFname(i);
-      std::ofstream ofs(ofname.c_str(), std::ios::out | std::ios::binary);
-      for (unsigned j = 0; j < num_threads; ++j) {
-        BucketStorage ins(GetUniqueKMersFname(i + j * num_buckets), Seq::GetDataSize(k_), /* unlink */ true);
-        ofs.write((const char*)ins.data(), ins.data_size());
-      }
-    }
-
     this->kmers_ = kmers;
     this->counted_ = true;
 
@@ -175,102 +167,101 @@ public:
     return final_kmers_;
   }
 
-private:
+protected:
   fs::TmpDir work_dir_;
   fs::TmpFile kmer_prefix_;
   fs::TmpFile final_kmers_;
   KMerSplitter<Seq> &splitter_;
   unsigned k_;
 
-  std::string GetUniqueKMersFname(unsigned suffix) const {
-    return kmer_prefix_->file() + ".unique." + std::to_string(suffix);
+  std::vector<std::string> MergedKMersFnames() const {
+    std::vector<std::string> res;
+    for (unsigned i = 0; i < this->num_buckets_; ++i)
+      res.push_back(GetMergedKMersFname(i));
+    return res;
   }
+};
 
-  size_t MergeKMers(const std::string &ifname, const std::string &ofname) {
-    MMappedRecordArrayReader<typename Seq::DataType> ins(ifname, Seq::GetDataSize(k_), /* unlink */ true);
-
-    std::string IdxFileName = ifname + ".idx";
-    if (FILE *f = fopen(IdxFileName.c_str(), "rb")) {
-      fclose(f);
-      MMappedRecordReader<size_t> index(ifname + ".idx", true, -1ULL);
-
-      // INFO("Total runs: " << index.size());
+// Keeps the raw k-mer runs in memory buckets instead of temporary files. Falls
+// back to disk for the buckets which do not fit into the memory budget, and to
+// the whole disk-based counting when the k-mer cardinality estimate says the
+// k-mers would not fit anyway.
+template<class Seq, class traits = kmer_index_traits<Seq> >
+class KMerMemoryCounter : public KMerDiskCounter<Seq, traits> {
+  typedef KMerDiskCounter<Seq, traits> __super;
+public:
+  KMerMemoryCounter(fs::TmpDir work_dir,
+                    KMerSplitter<Seq> &splitter,
+                    size_t kmers_estimate = 0)
+      : __super(work_dir, splitter), kmers_estimate_(kmers_estimate) {}
 
-      // Prepare runs
-      std::vector<adt::iterator_range<decltype(ins.begin())>> ranges;
-      auto beg = ins.begin();
-      for (size_t sz : index) {
-        auto end = std::next(beg, sz);
-        ranges.push_back(adt::make_range(beg, end));
-        VERIFY(std::is_sorted(beg, end, adt::array_less<typename Seq::DataType>()));
-        beg = end;
-      }
+  KMerMemoryCounter(const std::string &work_dir,
+                    KMerSplitter<Seq> &splitter,
+                    size_t kmers_estimate = 0)
+      : __super(work_dir, splitter), kmers_estimate_(kmers_estimate) {}
 
-      // Construct tree on top entries of runs
-      adt::loser_tree<decltype(beg),
-              adt::array_less<typename Seq::DataType>> tree(ranges);
+  size_t Count(unsigned num_buckets, unsigned num_threads) override {
+    // Shared by the buckets and the splitting buffers, the rest is left for
+    // the merged k-mers
+    size_t limit = utils::get_free_memory() / 2;
+    if (!kmers_estimate_) {
+      INFO("No k-mer cardinality estimate, using disk-based k-mer counting");
+      return __super::Count(num_buckets, num_threads);
+    }
+    if (2 * kmers_estimate_ * this->kmer_size() > limit) {
+      INFO("Estimated " << kmers_estimate_ << " distinct kmers do not fit into memory, using disk-based k-mer counting");
+      return __super::Count(num_buckets, num_threads);
+    }
 
-      if (tree.empty()) {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        fclose(g);
-        return 0;
-      }
+    this->num_buckets_ = num_buckets;
+    unsigned num_files = num_buckets * num_threads;
 
-      // Write it down!
-      adt::KMerVector<Seq> buf(k_, 1024*1024);
-      auto pval = tree.pop();
-      size_t total = 0;
-      while (!tree.empty()) {
-          buf.clear();
-          for (size_t cnt = 0; cnt < buf.capacity() && !tree.empty(); ) {
-              auto cval = tree.pop();
-              if (!adt::array_equal_to<typename Seq::DataType>()(pval, cval)) {
-                  buf.push_back(pval);
-                  pval = cval;
-                  cnt += 1;
-              }
-          }
-          total += buf.size();
-
-          FILE *g = fopen(ofname.c_str(), "ab");
-          if (!g)
-            FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-          size_t res = fwrite(buf.data(), buf.el_data_size(), buf.size(), g);
-          if (res != buf.size())
-            FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-          fclose(g);
-      }
+    // Split k-mers into buckets.
+    INFO("Splitting kmer instances into " << num_files << " in-memory buckets using " << num_threads << " threads. This might take a while.");
+    INFO("Memory available for k-mer buckets and splitting buffers: " << (double)limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
+    KMerMemoryBuckets<Seq> buckets(this->k_, num_files, limit);
+    this->splitter_.set_memory_buckets(&buckets);
+    auto raw_kmers = this->splitter_.Split(num_files, num_threads);
+    this->splitter_.set_memory_buckets(nullptr);
+
+    size_t spilled = 0;
+    for (unsigned i = 0; i < num_files; ++i)
+      spilled += buckets.spilled(i);
+    if (spilled)
+      INFO(spilled << " buckets did not fit into memory and were spilled to disk");
 
-      // Handle very last value
-      {
-        FILE *g = fopen(ofname.c_str(), "ab");
-        if (!g)
-          FATAL_ERROR("Cannot open temporary file " << ofname << " for writing");
-        size_t res = fwrite(pval.data(), pval.data_size(), 1, g);
-        if (res != 1)
-          FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-        fclose(g);
-        total += 1;
+    INFO("Starting k-mer counting.");
+    KMerRunMerger<Seq> merger(this->k_);
+    std::vector<typename KMerRunMerger<Seq>::RunSet> runs(num_files);
+    for (unsigned i = 0; i < num_files; ++i) {
+      auto &set = runs[i];
+      auto beg = buckets.begin(i);
+      for (size_t sz : buckets.runs(i)) {
+        auto end = std::next(beg, sz);
+        set.runs.push_back(adt::make_range(beg, end));
+        beg = end;
       }
+      // Spilled runs, if any
+      merger.LoadRuns(*raw_kmers[i], set);
+      set.release = [&buckets, i]() { buckets.release(i); };
+    }
 
-      return total;
-    } else {
-      // Sort the stuff
-      libcxx::sort(ins.begin(), ins.end(), adt::array_less<typename Seq::DataType>());
-
-      // FIXME: Use something like parallel version of unique_copy but with explicit
-      // resizing.
-      auto it = std::unique(ins.begin(), ins.end(), adt::array_equal_to<typename Seq::DataType>());
+    size_t kmers = merger.Merge(runs, this->MergedKMersFnames(), num_threads);
+    raw_kmers.clear();
+    INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
+    if (!kmers) {
+      FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
+      exit(-1);
+    }
 
-      MMappedRecordArrayWriter<typename Seq::DataType> os(ofname, Seq::GetDataSize(k_));
-      os.resize(it - ins.begin());
-      std::copy(ins.begin(), it, os.begin());
+    this->kmers_ = kmers;
+    this->counted_ = true;
 
-      return it - ins.begin();
-    }
+    return kmers;
   }
+
+private:
+  size_t kmers_estimate_;
 };
 
 template<class Index>
@@ -0,0 +1,228 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "io/kmers/mmapped_reader.hpp"
+#include "adt/kmer_vector.hpp"
+#include "adt/iterator_range.hpp"
+#include "adt/loser_tree.hpp"
+
+#include "utils/filesystem/path_helper.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/logger/logger.hpp"
+#include "utils/verify.hpp"
+
+#include <libcxx/sort.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+namespace utils {
+
+// Merges sets of sorted k-mer runs into the final buckets removing the
+// duplicates. The runs of every input are range-partitioned by the splitter
+// k-mers sampled from the runs themselves, so several threads could merge the
+// disjoint key ranges of a single big input simultaneously. Merged ranges are
+// written in order through one buffered handle per output, the result is the
+// same as of the sequential merge of every input followed by concatenation.
+template<class Seq>
+class KMerRunMerger {
+    typedef typename Seq::DataType ElTy;
+    typedef MMappedRecordArrayReader<ElTy> RunStorage;
+    typedef adt::KMerVector<Seq> KMerBuffer;
+
+  public:
+    typedef typename adt::array_vector<ElTy>::iterator iterator;
+    typedef adt::iterator_range<iterator> Run;
+
+    struct RunSet {
+        std::vector<Run> runs;
+        std::unique_ptr<RunStorage> storage;
+        std::unique_ptr<KMerBuffer> sorted;
+        // Called once all the runs of the set were merged
+        std::function<void()> release;
+    };
+
+    KMerRunMerger(unsigned K, size_t range_size = 64 * 1024 * 1024)
+            : K_(K), range_size_(range_size) {}
+
+    // Appends the runs of the raw k-mers file produced by the splitter.
+    void LoadRuns(const std::string &ifname, RunSet &set) const {
+        std::string idxname = ifname + ".idx";
+        if (!fs::FileExists(ifname))
+            return;
+
+        set.storage.reset(new RunStorage(ifname, Seq::GetDataSize(K_), /* unlink */ true));
+        auto beg = set.storage->begin();
+        if (!fs::FileExists(idxname)) {
+            // Single unsorted run, the mapping is read-only, so it is sorted
+            // in memory
+            size_t cnt = set.storage->size(), el_size = Seq::GetDataSize(K_);
+            set.sorted.reset(new KMerBuffer(K_, cnt));
+            for (size_t i = 0; i < cnt; ++i)
+                set.sorted->push_back(set.storage->data() + i * el_size);
+            set.storage.reset();
+
+            libcxx::sort(set.sorted->begin(), set.sorted->end(), adt::array_less<ElTy>());
+            auto end = std::unique(set.sorted->begin(), set.sorted->end(), adt::array_equal_to<ElTy>());
+            set.runs.push_back(adt::make_range(set.sorted->begin(), end));
+            return;
+        }
+
+        MMappedRecordReader<size_t> index(idxname, /* unlink */ true, -1ULL);
+        for (size_t sz : index) {
+            auto end = std::next(beg, sz);
+            set.runs.push_back(adt::make_range(beg, end));
+            VERIFY(std::is_sorted(beg, end, adt::array_less<ElTy>()));
+            beg = end;
+        }
+    }
+
+    // Merges the inputs into the given output files. Input i goes into output
+    // i % outputs.size(), the inputs of the same output are written in order.
+    size_t Merge(std::vector<RunSet> &inputs,
+                 const std::vector<std::string> &outputs,
+                 unsigned num_threads) const {
+        struct Task {
+            size_t input;
+            size_t output;
+            std::vector<Run> runs;
+        };
+
+        size_t num_outputs = outputs.size();
+        std::vector<Task> tasks;
+        std::vector<size_t> remaining(inputs.size(), 0);
+        for (size_t o = 0; o < num_outputs; ++o) {
+            for (size_t i = o; i < inputs.size(); i += num_outputs) {
+                auto parts = Partition(inputs[i].runs);
+                remaining[i] = parts.size();
+                for (auto &part : parts)
+                    tasks.push_back({ i, o, std::move(part) });
+            }
+        }
+
+        std::vector<FILE*> outs(num_outputs);
+        for (size_t o = 0; o < num_outputs; ++o) {
+            outs[o] = fopen(outputs[o].c_str(), "wb");
+            if (!outs[o])
+                FATAL_ERROR("Cannot open temporary file " << outputs[o] << " for writing");
+            setvbuf(outs[o], nullptr, _IOFBF, 4 * 1024 * 1024);
+        }
+
+        std::vector<KMerBuffer> buffers;
+        buffers.reserve(num_threads);
+        for (unsigned i = 0; i < num_threads; ++i)
+            buffers.emplace_back(K_, 0);
+
+        size_t kmers = 0;
+#       pragma omp parallel for ordered schedule(dynamic, 1) num_threads(num_threads) reduction(+:kmers)
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            Task &task = tasks[t];
+            KMerBuffer &buf = buffers[omp_get_thread_num()];
+            buf.clear();
+            MergeRuns(task.runs, buf);
+            kmers += buf.size();
+
+#           pragma omp ordered
+            {
+                size_t res = fwrite(buf.data(), buf.el_data_size(), buf.size(), outs[task.output]);
+                if (res != buf.size())
+                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+
+                if (--remaining[task.input] == 0) {
+                    RunSet &input = inputs[task.input];
+                    input.runs.clear();
+                    input.storage.reset();
+                    input.sorted.reset();
+                    if (input.release)
+                        input.release();
+                }
+            }
+        }
+
+        for (FILE *f : outs)
+            fclose(f);
+
+        return kmers;
+    }
+
+  private:
+    unsigned K_;
+    size_t range_size_;
+
+    std::vector<std::vector<Run>> Partition(const std::vector<Run> &runs) const {
+        size_t total = 0;
+        for (const auto &run : runs)
+            total += run.end() - run.begin();
+
+        size_t parts = (total * Seq::GetDataSize(K_) * sizeof(ElTy) + range_size_ - 1) / range_size_;
+        if (parts <= 1)
+            return { runs };
+
+        // Sample the runs uniformly and pick the splitters out of the sorted sample
+        size_t stride = std::max(total / (parts * 16), size_t(1));
+        KMerBuffer sample(K_, total / stride + runs.size());
+        for (const auto &run : runs) {
+            size_t sz = run.end() - run.begin();
+            for (size_t i = 0; i < sz; i += stride)
+                sample.push_back(*(run.begin() + i));
+        }
+        libcxx::sort(sample.begin(), sample.end(), adt::array_less<ElTy>());
+
+        KMerBuffer splitters(K_, parts);
+        size_t el_size = Seq::GetDataSize(K_);
+        for (size_t p = 1; p < parts; ++p) {
+            const ElTy *splitter = sample[p * sample.size() / parts];
+            if (splitters.size() &&
+                std::equal(splitter, splitter + el_size, splitters[splitters.size() - 1]))
+                continue;
+            splitters.push_back(splitter);
+        }
+
+        // Every range is [previous splitter, current splitter)
+        std::vector<std::vector<Run>> res(splitters.size() + 1);
+        for (const auto &run : runs) {
+            auto beg = run.begin();
+            for (size_t s = 0; s < splitters.size(); ++s) {
+                auto end = std::lower_bound(beg, run.end(), *(splitters.begin() + s), adt::array_less<ElTy>());
+                res[s].push_back(adt::make_range(beg, end));
+                beg = end;
+            }
+            res.back().push_back(adt::make_range(beg, run.end()));
+        }
+
+        return res;
+    }
+
+    void MergeRuns(const std::vector<Run> &runs, KMerBuffer &out) const {
+        if (runs.empty())
+            return;
+
+        adt::loser_tree<iterator, adt::array_less<ElTy>> tree(runs);
+        if (tree.empty())
+            return;
+
+        auto pval = tree.pop();
+        while (!tree.empty()) {
+            auto cval = tree.pop();
+            if (!adt::array_equal_to<ElTy>()(pval, cval)) {
+                out.push_back(pval);
+                pval = cval;
+            }
+        }
+        out.push_back(pval);
+    }
+};
+
+}
@@ -7,11 +7,15 @@
 
 #pragma once
 
+#include "kmer_buckets.hpp"
+
 #include "adt/kmer_vector.hpp"
 #include "io/reads/io_helper.hpp"
+#include "sequence/rolling_kmers.hpp"
 #include "utils/filesystem/file_limit.hpp"
 #include "utils/filesystem/temporary.hpp"
 #include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 #include <libcxx/sort.hpp>
 
@@ -39,11 +43,16 @@ public:
 
     unsigned K() const { return K_; }
 
+    // When set, the sorted runs are kept in memory buckets and only overflowing
+    // buckets are written to the output files.
+    void set_memory_buckets(KMerMemoryBuckets<Seq> *buckets) { memory_buckets_ = buckets; }
+
 protected:
     fs::TmpDir work_dir_;
     hash_function hash_;
     unsigned K_;
     uint32_t seed_;
+    KMerMemoryBuckets<Seq> *memory_buckets_ = nullptr;
 
     DECL_LOGGER("K-mer Splitting");
 };
@@ -66,6 +75,7 @@ protected:
     std::vector<KMerBuffer> kmer_buffers_;
     size_t cell_size_;
     size_t num_files_;
+    size_t charged_ = 0;
 
     RawKMers PrepareBuffers(size_t num_files, unsigned nthreads, size_t reads_buffer_size) {
         num_files_ = num_files;
@@ -85,7 +95,9 @@ protected:
 
         if (reads_buffer_size == 0) {
             reads_buffer_size = 536870912ull;
-            size_t mem_limit =  (size_t)((double)(utils::get_free_memory()) / (nthreads * 3));
+            // In-memory buckets share their budget with the buffers
+            size_t free_mem = this->memory_buckets_ ? this->memory_buckets_->limit() : utils::get_free_memory();
+            size_t mem_limit =  (size_t)((double)free_mem / (nthreads * 3));
             INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
             reads_buffer_size = std::min(reads_buffer_size, mem_limit);
         }
@@ -101,6 +113,13 @@ protected:
             entry.resize(num_files_, adt::KMerVector<Seq>(this->K_, (size_t) (1.1 * (double) cell_size_)));
         }
 
+        if (this->memory_buckets_) {
+            // Per-thread buffers plus the sort buffers of the concurrent dumps
+            size_t buffer_size = (size_t) (1.1 * (double) cell_size_) * this->kmer_size();
+            charged_ = buffer_size * nthreads * (num_files_ + omp_get_max_threads());
+            this->memory_buckets_->charge(charged_);
+        }
+
         return out;
     }
 
@@ -112,6 +131,16 @@ protected:
         return entry[idx].size() > cell_size_;
     }
 
+    // Same as above, but for the raw k-mer data. The bucket is chosen via
+    // Seq::GetHash which is consistent with Seq::hash.
+    bool push_back_internal(const typename Seq::DataType *data, unsigned thread_id) {
+        KMerBuffer &entry = kmer_buffers_[thread_id];
+
+        size_t idx = (size_t)(Seq::GetHash(data, Seq::GetDataSize(this->K_), this->seed_) % num_files_);
+        entry[idx].push_back(data);
+        return entry[idx].size() > cell_size_;
+    }
+
     void DumpBuffers(const RawKMers &ostreams) {
         VERIFY(ostreams.size() == num_files_ && kmer_buffers_[0].size() == num_files_);
 
@@ -131,10 +160,15 @@ protected:
             }
             libcxx::sort(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::less2_fast());
             auto it = std::unique(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::equal_to());
+            size_t cnt =  it - SortBuffer.begin();
+
+            // Each file is processed by a single thread, so no locking is necessary here
+            if (this->memory_buckets_ &&
+                this->memory_buckets_->append(k, SortBuffer.data(), cnt))
+                continue;
 
 #     pragma omp critical
             {
-                size_t cnt =  it - SortBuffer.begin();
 
                 // Write k-mers
                 FILE *f = fopen(ostreams[k]->file().c_str(), "ab");
@@ -167,6 +201,10 @@ protected:
                 eentry.clear();
                 eentry.shrink_to_fit();
             }
+
+        if (this->memory_buckets_)
+            this->memory_buckets_->uncharge(charged_);
+        charged_ = 0;
     }
 
     unsigned GetFileNumForSeq(const Seq &s, unsigned total) const {
@@ -184,37 +222,18 @@ class DeBruijnKMerSplitter : public RtSeqKMerSplitter {
  protected:
   size_t read_buffer_size_;
  protected:
-  bool FillBufferFromSequence(const Sequence &seq,
+  template<class S>
+  bool FillBufferFromSequence(const S &seq,
                               unsigned thread_id) {
       if (seq.size() < this->K_)
         return false;
 
-      RtSeq kmer = seq.start<RtSeq>(this->K_) >> 'A';
-      bool stop = false;
-      for (size_t j = this->K_ - 1; j < seq.size(); ++j) {
-        kmer <<= seq[j];
-        if (!kmer_filter_.filter(kmer))
-          continue;
-
-        stop |= this->push_back_internal(kmer, thread_id);
-      }
-
-      return stop;
-  }
-
-    bool FillBufferFromSequence(const RtSeq &seq,
-                                unsigned thread_id) {
-      if (seq.size() < this->K_)
-        return false;
-
-      RtSeq kmer = seq.start(this->K_) >> 'A';
       bool stop = false;
-      for (size_t j = this->K_ - 1; j < seq.size(); ++j) {
-        kmer <<= seq[j];
-        if (!kmer_filter_.filter(kmer))
+      for (RollingKMerIterator<RtSeq> it(seq, this->K_); it.good(); it.next(seq)) {
+        if (!kmer_filter_.filter(it))
           continue;
 
-        stop |= this->push_back_internal(kmer, thread_id);
+        stop |= this->push_back_internal(it.fwd_data(), thread_id);
       }
 
       return stop;
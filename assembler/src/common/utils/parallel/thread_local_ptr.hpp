@@ -0,0 +1,38 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+
+namespace utils {
+
+/**
+ * Pointer to the private state the current thread should work with instead of
+ * the shared one, e.g. a log of the changes made speculatively. Every Tag gets
+ * a slot of its own, the pointer is null unless set by the thread.
+ */
+template<class T, class Tag = T>
+class ThreadLocalPtr {
+public:
+    static T *get() {
+        return slot();
+    }
+
+    // Sets the pointer for the current thread (or resets it if null), a set one must be reset first
+    static void set(T *value) {
+        VERIFY(!value || !slot());
+        slot() = value;
+    }
+
+private:
+    static T *&slot() {
+        static thread_local T *value = nullptr;
+        return value;
+    }
+};
+
+}
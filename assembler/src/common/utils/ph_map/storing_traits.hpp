@@ -8,6 +8,7 @@
 #pragma once
 
 #include "values.hpp"
+#include "sequence/rolling_kmers.hpp"
 #include "utils/verify.hpp"
 
 namespace utils {
@@ -91,6 +92,11 @@ struct StoringTypeFilter<InvertableStoring> {
     bool filter(const Kmer &kmer) const {
         return kmer.IsMinimal();
     }
+
+    template<class Kmer>
+    bool filter(const RollingKMerIterator<Kmer> &it) const {
+        return it.is_minimal();
+    }
 };
 
 }
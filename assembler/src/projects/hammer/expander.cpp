@@ -13,24 +13,44 @@
 #include "valid_kmer_generator.hpp"
 
 #include "io/reads/read.hpp"
+#include "sequence/nucl.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 #include <vector>
 #include <cstring>
 
-bool Expander::operator()(std::unique_ptr<Read> r) {
-  uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
+void PackedReads::push_back(const std::string &seq) {
+  size_t pos = starts_.back();
+  starts_.push_back(pos + seq.size());
+  data_.resize((starts_.back() + 31) / 32, 0);
+  for (char c : seq) {
+    data_[pos / 32] |= uint64_t(dignucl(c)) << (2 * (pos % 32));
+    pos += 1;
+  }
+}
 
-  // FIXME: Get rid of this
-  Read cr = *r;
-  size_t sz = cr.trimNsAndBadQuality(trim_quality);
+void PackedReads::get(size_t i, std::string &seq) const {
+  seq.resize(starts_[i + 1] - starts_[i]);
+  for (size_t pos = starts_[i], j = 0; j < seq.size(); ++pos, ++j)
+    seq[j] = nucl((data_[pos / 32] >> (2 * (pos % 32))) & 3);
+}
 
-  if (sz < hammer::K)
-    return false;
+Expander::Expander(KMerData &data, unsigned nthreads)
+    : data_(data), nthreads_(nthreads), changed_(0), candidates_(nthreads) {}
 
+size_t Expander::candidates() const {
+  size_t res = 0;
+  for (const auto &reads : candidates_)
+    res += reads.size();
+  return res;
+}
+
+Expander::Coverage Expander::Expand(const char *seq, const char *qual, size_t sz) {
   std::vector<unsigned> covered_by_solid(sz, false);
+  std::vector<unsigned> covered_by_index(sz, false);
   std::vector<size_t> kmer_indices(sz, -1ull);
 
-  ValidKMerGenerator<hammer::K> gen(cr);
+  ValidKMerGenerator<hammer::K> gen(seq, qual, sz);
   while (gen.HasMore()) {
     hammer::KMer kmer = gen.kmer();
     size_t idx = data_.checking_seq_idx(kmer);
@@ -38,17 +58,22 @@ bool Expander::operator()(std::unique_ptr<Read> r) {
       size_t read_pos = gen.pos() - 1;
 
       kmer_indices[read_pos] = idx;
-      if (data_[idx].good()) {
-        for (size_t j = read_pos; j < read_pos + hammer::K; ++j)
-          covered_by_solid[j] = true;
+      bool good = data_[idx].good();
+      for (size_t j = read_pos; j < read_pos + hammer::K; ++j) {
+        covered_by_index[j] = true;
+        covered_by_solid[j] |= good;
       }
     }
     gen.Next();
   }
 
+  for (size_t j = 0; j < sz; ++j)
+    if (!covered_by_index[j])
+      return Coverage::None;
+
   for (size_t j = 0; j < sz; ++j)
     if (!covered_by_solid[j])
-      return false;
+      return Coverage::Index;
 
   for (size_t j = 0; j < sz; ++j) {
     if (kmer_indices[j] == -1ull)
@@ -65,6 +90,53 @@ bool Expander::operator()(std::unique_ptr<Read> r) {
       kmer_data.unlock();
     }
   }
-    
+
+  return Coverage::Solid;
+}
+
+bool Expander::operator()(const Read &r) {
+  uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
+
+  // FIXME: Get rid of this
+  Read cr = r;
+  size_t sz = cr.trimNsAndBadQuality(trim_quality);
+
+  if (sz < hammer::K)
+    return false;
+
+  const std::string &seq = cr.getSequenceString();
+  if (Expand(seq.data(), cr.getQualityString().data(), sz) == Coverage::Index)
+    candidates_[omp_get_thread_num()].push_back(seq);
+
   return false;
 }
+
+void Expander::ExpandCandidates() {
+  changed_ = 0;
+
+  // Every nucleotide of a candidate is covered by a k-mer, so neither Ns nor
+  // the low quality ends could be there and the qualities are not needed
+  std::vector<PackedReads> remaining(candidates_.size());
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    const PackedReads &reads = candidates_[i];
+    std::vector<uint8_t> solid(reads.size(), false);
+#   pragma omp parallel num_threads(nthreads_)
+    {
+      std::string seq;
+#     pragma omp for schedule(guided)
+      for (size_t j = 0; j < reads.size(); ++j) {
+        reads.get(j, seq);
+        solid[j] = (Expand(seq.data(), nullptr, seq.size()) == Coverage::Solid);
+      }
+    }
+
+    for (size_t j = 0; j < reads.size(); ++j) {
+      if (solid[j])
+        continue;
+      std::string seq;
+      reads.get(j, seq);
+      remaining[i].push_back(seq);
+    }
+  }
+  candidates_.swap(remaining);
+}
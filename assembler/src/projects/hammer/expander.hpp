@@ -12,19 +12,49 @@ class KMerData;
 class Read;
 
 #include <cstring>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
+
+// Nucleotide sequences packed one after another, 2 bits per nucleotide
+class PackedReads {
+  std::vector<uint64_t> data_;
+  std::vector<size_t> starts_;
+
+ public:
+  PackedReads()
+      : starts_(1, 0) {}
+
+  size_t size() const { return starts_.size() - 1; }
+
+  // The sequence must consist of ACGT only
+  void push_back(const std::string &seq);
+  void get(size_t i, std::string &seq) const;
+};
 
 class Expander {
   KMerData &data_;
+  unsigned nthreads_;
   size_t changed_;
-  
+  // Reads which are not covered by solid k-mers, but are covered by k-mers
+  // from the index. Only they might get covered at the next iterations.
+  std::vector<PackedReads> candidates_;
+
+  enum class Coverage { Solid, Index, None };
+
+  Coverage Expand(const char *seq, const char *qual, size_t sz);
+
  public:
-  Expander(KMerData &data) 
-      : data_(data), changed_(0) {}
+  Expander(KMerData &data, unsigned nthreads);
 
   size_t changed() const { return changed_; }
+  size_t candidates() const;
 
-  bool operator()(std::unique_ptr<Read> r);
+  // The first iteration, goes over all the reads and collects the candidates
+  bool operator()(const Read &r);
+  // The subsequent iterations, go over the remaining candidates only
+  void ExpandCandidates();
 };
 
 #endif
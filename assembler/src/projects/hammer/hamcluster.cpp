@@ -14,6 +14,8 @@
 #include "config_struct_hammer.hpp"
 #include "globals.hpp"
 
+#include "utils/memory_limit.hpp"
+
 #include <iostream>
 #include <sstream>
 
@@ -38,12 +40,10 @@ struct SubKMerComparator {
     }
 };
 
-template<class Op>
-std::pair<size_t, size_t> SubKMerSplitter::split(Op &&op) {
+template<class Reader, class Op>
+std::pair<size_t, size_t> SubKMerSplitter::split(Reader &bifs, Reader &kifs, Op &&op) {
   std::vector<SubKMer> data; std::vector<size_t> blocks;
 
-  MMappedReader bifs(bifname_, /* unlink */ true);
-  MMappedReader kifs(kifname_, /* unlink */ true);
   size_t icnt = 0, ocnt = 0;
   while (bifs.good()) {
     deserialize(blocks, data, bifs, kifs);
@@ -93,29 +93,100 @@ static void processBlockQuadratic(dsu::ConcurrentDSU  &uf,
                                   size_t block_size,
                                   const KMerData &data,
                                   unsigned tau) {
-  for (size_t i = 0; i < block_size; ++i) {
-    size_t x = block[i];
-    hammer::KMer kmerx = data.kmer(x);
-    for (size_t j = i + 1; j < block_size; j++) {
-      size_t y = block[j];
-      hammer::KMer kmery = data.kmer(y);
-      if (!uf.same(x, y) &&
-          canMerge(uf, x, y) &&
-          hamdistKMer(kmerx, kmery, tau) <= tau) {
-        uf.unite(x, y);
+  // Small enough to fit L1 for both the row and the column tile
+  const size_t tile = 256;
+  // Limits the number of close pairs kept at once
+  const size_t window_cells = 1 << 24;
+
+  std::vector<hammer::KMer> kmers;
+  kmers.reserve(block_size);
+  for (size_t i = 0; i < block_size; ++i)
+    kmers.push_back(data.kmer(block[i]));
+
+  if (block_size < 2 * tile) {
+    for (size_t i = 0; i < block_size; ++i) {
+      size_t x = block[i];
+      for (size_t j = i + 1; j < block_size; j++) {
+        size_t y = block[j];
+        if (hamdistPacked(kmers[i], kmers[j]) <= tau &&
+            !uf.same(x, y) &&
+            canMerge(uf, x, y)) {
+          uf.unite(x, y);
+        }
+      }
+    }
+    return;
+  }
+
+  // Large blocks: close pairs are found tile by tile in parallel and then
+  // united in the same order as above, since canMerge depends on it.
+  unsigned nthreads = cfg::get().general_max_nthreads;
+  size_t window = std::max(tile, window_cells / block_size / tile * tile);
+  for (size_t wstart = 0; wstart < block_size; wstart += window) {
+    size_t wend = std::min(block_size, wstart + window);
+    size_t ntiles = (wend - wstart + tile - 1) / tile;
+    std::vector<std::vector<std::pair<size_t, size_t>>> pairs(ntiles);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+    for (size_t t = 0; t < ntiles; ++t) {
+      size_t rstart = wstart + t * tile, rend = std::min(wend, rstart + tile);
+      auto &tile_pairs = pairs[t];
+      for (size_t cstart = rstart; cstart < block_size; cstart += tile) {
+        size_t cend = std::min(block_size, cstart + tile);
+        for (size_t i = rstart; i < rend; ++i) {
+          for (size_t j = std::max(cstart, i + 1); j < cend; ++j) {
+            if (hamdistPacked(kmers[i], kmers[j]) <= tau)
+              tile_pairs.emplace_back(i, j);
+          }
+        }
+      }
+      std::sort(tile_pairs.begin(), tile_pairs.end());
+    }
+
+    for (const auto &tile_pairs : pairs) {
+      for (const auto &p : tile_pairs) {
+        size_t x = block[p.first], y = block[p.second];
+        if (!uf.same(x, y) && canMerge(uf, x, y))
+          uf.unite(x, y);
       }
     }
   }
 }
 
+// Upper bound on the number of sub-k-mers and blocks after the given pass:
+// (tau + 1) sub-k-mers per k-mer after the first one and at most (tau + 1)^2
+// after the second one, in blocks not smaller than the quadratic threshold
+static std::pair<size_t, size_t> subKMerVolume(unsigned tau, size_t nkmers, unsigned pass) {
+  size_t kmers = (tau + 1) * nkmers;
+  if (pass == 1)
+    return { kmers, tau + 1 };
+
+  kmers *= tau + 1;
+  return { kmers, kmers / std::max(cfg::get().hamming_blocksize_quadratic_threshold, 1u) };
+}
+
+void KMerHamClusterer::cluster(const std::string &prefix,
+                               const KMerData &data,
+                               dsu::ConcurrentDSU &uf) {
+  // Both passes are kept at once
+  auto first = subKMerVolume(tau_, data.size(), 1), second = subKMerVolume(tau_, data.size(), 2);
+  size_t max_size = SubKMerMemoryStorage::volume(first.first, first.second) +
+                    SubKMerMemoryStorage::volume(second.first, second.second);
+  if (max_size < utils::get_free_memory() / 2) {
+    INFO("Sub-kmers are kept in memory");
+    cluster<SubKMerMemoryStorage>(prefix, data, uf);
+  } else {
+    cluster<SubKMerFileStorage>(prefix, data, uf);
+  }
+}
+
+template<class Storage>
 void KMerHamClusterer::cluster(const std::string &prefix,
                                const KMerData &data,
                                dsu::ConcurrentDSU &uf) {
   // First pass - split & sort the k-mers
-  std::string fname = prefix + ".first", bfname = fname + ".blocks", kfname = fname + ".kmers";
-  std::ofstream bfs(bfname, std::ios::out | std::ios::binary);
-  std::ofstream kfs(kfname, std::ios::out | std::ios::binary);
-  VERIFY(bfs.good()); VERIFY(kfs.good());
+  auto first_volume = subKMerVolume(tau_, data.size(), 1);
+  std::unique_ptr<Storage> first(new Storage(prefix + ".first", first_volume.first, first_volume.second));
 
   INFO("Serializing sub-kmers.");
   for (unsigned i = 0; i < tau_ + 1; ++i) {
@@ -123,27 +194,20 @@ void KMerHamClusterer::cluster(const std::string &prefix,
     size_t to = (*Globals::subKMerPositions)[i+1];
 
     INFO("Serializing: [" << from << ", " << to << ")");
-    serialize(bfs, kfs,
+    serialize(first->blocks(), first->kmers(),
               data, NULL, 0,
               SubKMerPartSerializer(from, to));
   }
-  VERIFY(!bfs.fail()); VERIFY(!kfs.fail());
-  bfs.close(); kfs.close();
 
   size_t big_blocks1 = 0;
+  auto second_volume = subKMerVolume(tau_, data.size(), 2);
+  std::unique_ptr<Storage> second(new Storage(prefix + ".second", second_volume.first, second_volume.second));
   {
     unsigned block_thr = cfg::get().hamming_blocksize_quadratic_threshold;
 
     INFO("Splitting sub-kmers, pass 1.");
-    SubKMerSplitter Splitter(bfname, kfname);
-
-    fname = prefix + ".second", bfname = fname + ".blocks", kfname = fname + ".kmers";
-    bfs.open(bfname, std::ios::out | std::ios::binary);
-    kfs.open(kfname, std::ios::out | std::ios::binary);
-    VERIFY(bfs.good()); VERIFY(kfs.good());
-
     std::pair<size_t, size_t> stat =
-      Splitter.split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
+      first->split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
         if (sz < block_thr) {
           // Merge small blocks.
           processBlockQuadratic(uf, start, sz, data, tau_);
@@ -151,12 +215,13 @@ void KMerHamClusterer::cluster(const std::string &prefix,
           big_blocks1 += 1;
           // Otherwise - dump for next iteration.
           for (unsigned i = 0; i < tau_ + 1; ++i) {
-            serialize(bfs, kfs,
+            serialize(second->blocks(), second->kmers(),
                       data, &start, sz,
                       SubKMerStridedSerializer(i, tau_ + 1));
           }
         }
     });
+    first.reset();
     INFO("Splitting done."
          " Processed " << stat.first << " blocks."
          " Produced " << stat.second << " blocks.");
@@ -166,18 +231,15 @@ void KMerHamClusterer::cluster(const std::string &prefix,
     VERIFY(stat.first == tau_ + 1);
     VERIFY(stat.second <= (tau_ + 1) * data.size());
 
-    VERIFY(!bfs.fail()); VERIFY(!kfs.fail());
-    bfs.close(); kfs.close();
     INFO("Merge done, total " << big_blocks1 << " new blocks generated.");
   }
 
   size_t big_blocks2 = 0;
   {
     INFO("Spliting sub-kmers, pass 2.");
-    SubKMerSplitter Splitter(bfname, kfname);
     size_t nblocks = 0;
     std::pair<size_t, size_t> stat =
-      Splitter.split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
+      second->split([&] (const std::vector<size_t>::iterator &start, size_t sz) {
         if (sz > 50) {
           big_blocks2 += 1;
 #if 0
@@ -190,6 +252,7 @@ void KMerHamClusterer::cluster(const std::string &prefix,
         processBlockQuadratic(uf, start, sz, data, tau_);
         nblocks += 1;
     });
+    second.reset();
     INFO("Splitting done."
             " Processed " << stat.first << " blocks."
             " Produced " << stat.second << " blocks.");
@@ -15,6 +15,8 @@
 #include "utils/logger/logger.hpp"
 #include "sequence/seq.hpp"
 
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <common/adt/concurrent_dsu.hpp>
@@ -103,24 +105,11 @@ void serialize(Writer &blocks, Writer &kmers,
 }
 
 class SubKMerSplitter {
-  const std::string bifname_, kifname_;
-
  public:
-  SubKMerSplitter(const std::string &bifname, const std::string &kifname)
-      : bifname_(bifname), kifname_(kifname) {}
-
-  template<class Writer>
-  void serialize(Writer &os,
-                 const std::vector<size_t>::iterator &start,
-                 size_t sz) {
-    os.write((char*)&sz, sizeof(sz));
-    os.write((char*)&*start, sz * sizeof(*start));
-  }
-
   template<class Reader>
-  void deserialize(std::vector<size_t> &blocks,
-                   std::vector<SubKMer> &kmers,
-                   Reader &bis, Reader &kis) {
+  static void deserialize(std::vector<size_t> &blocks,
+                          std::vector<SubKMer> &kmers,
+                          Reader &bis, Reader &kis) {
     kmers.clear(); blocks.clear();
 
     size_t sz;
@@ -133,8 +122,84 @@ class SubKMerSplitter {
       binary_read(kis, kmers[i]);
   }
 
+  template<class Reader, class Op>
+  static std::pair<size_t, size_t> split(Reader &bifs, Reader &kifs, Op &&op);
+};
+
+// In-memory replacement of a temporary file with sub-k-mer blocks
+class SubKMerBuffer {
+  std::vector<char> data_;
+  size_t pos_;
+
+ public:
+  SubKMerBuffer()
+      : pos_(0) {}
+
+  void reserve(size_t amount) { data_.reserve(amount); }
+
+  void write(const char *buf, size_t amount) {
+    data_.insert(data_.end(), buf, buf + amount);
+  }
+
+  void read(void *buf, size_t amount) {
+    VERIFY(pos_ + amount <= data_.size());
+    memcpy(buf, data_.data() + pos_, amount);
+    pos_ += amount;
+  }
+
+  bool good() const { return pos_ < data_.size(); }
+};
+
+// Sub-k-mer blocks passed from one splitting pass to the next one
+// through a pair of temporary files
+class SubKMerFileStorage {
+  std::string bfname_, kfname_;
+  std::ofstream bfs_, kfs_;
+
+ public:
+  SubKMerFileStorage(const std::string &fname, size_t /* kmers */, size_t /* blocks */)
+      : bfname_(fname + ".blocks"), kfname_(fname + ".kmers"),
+        bfs_(bfname_, std::ios::out | std::ios::binary),
+        kfs_(kfname_, std::ios::out | std::ios::binary) {
+    VERIFY(bfs_.good()); VERIFY(kfs_.good());
+  }
+
+  std::ofstream &blocks() { return bfs_; }
+  std::ofstream &kmers() { return kfs_; }
+
   template<class Op>
-  std::pair<size_t, size_t> split(Op &&op);
+  std::pair<size_t, size_t> split(Op &&op) {
+    VERIFY(!bfs_.fail()); VERIFY(!kfs_.fail());
+    bfs_.close(); kfs_.close();
+
+    MMappedReader bifs(bfname_, /* unlink */ true);
+    MMappedReader kifs(kfname_, /* unlink */ true);
+    return SubKMerSplitter::split(bifs, kifs, std::forward<Op>(op));
+  }
+};
+
+// Same as above, but the blocks are kept in memory. The buffers are reserved
+// for the given number of sub-k-mers and blocks upfront and never grow beyond.
+class SubKMerMemoryStorage {
+  SubKMerBuffer blocks_, kmers_;
+
+ public:
+  SubKMerMemoryStorage(const std::string &, size_t kmers, size_t blocks) {
+    blocks_.reserve((kmers + blocks) * sizeof(size_t));
+    kmers_.reserve(kmers * sizeof(SubKMer));
+  }
+
+  static size_t volume(size_t kmers, size_t blocks) {
+    return (kmers + blocks) * sizeof(size_t) + kmers * sizeof(SubKMer);
+  }
+
+  SubKMerBuffer &blocks() { return blocks_; }
+  SubKMerBuffer &kmers() { return kmers_; }
+
+  template<class Op>
+  std::pair<size_t, size_t> split(Op &&op) {
+    return SubKMerSplitter::split(blocks_, kmers_, std::forward<Op>(op));
+  }
 };
 
 class KMerHamClusterer {
@@ -146,6 +211,9 @@ class KMerHamClusterer {
 
   void cluster(const std::string &prefix, const KMerData &data, dsu::ConcurrentDSU &uf);
  private:
+  template<class Storage>
+  void cluster(const std::string &prefix, const KMerData &data, dsu::ConcurrentDSU &uf);
+
   DECL_LOGGER("Hamming Clustering");
 };
 
@@ -16,6 +16,8 @@
 #include "io/kmers/mmapped_writer.hpp"
 #include "utils/filesystem/path_helper.hpp"
 
+#include <array>
+#include <future>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
@@ -76,7 +78,7 @@ string getFilename( const string & dirprefix, int iter_count, const string & suf
   return tmp.str();
 }
 
-CorrectionStats CorrectReadsBatch(std::vector<bool> &res,
+CorrectionStats CorrectReadsBatch(std::vector<uint8_t> &res,
                        std::vector<Read> &reads, size_t buf_size,
                        const KMerData &data) {
   unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
@@ -104,6 +106,62 @@ CorrectionStats CorrectReadsBatch(std::vector<bool> &res,
   return stats;
 }
 
+namespace {
+
+struct ReadBatch {
+  std::vector<Read> reads;
+  std::vector<uint8_t> res;
+  size_t size;
+
+  ReadBatch(size_t capacity)
+      : reads(capacity), res(capacity, 0), size(0) {}
+
+  void read(ireadstream &irs, int trim_quality) {
+    size = 0;
+    for (; size < reads.size() && !irs.eof(); ++size) {
+      irs >> reads[size];
+      reads[size].trimNsAndBadQuality(trim_quality);
+    }
+  }
+};
+
+// Batches go through three stages: while the current batch is being
+// corrected, the next one is read and the previous one is written out.
+// Three buffers are cycled, so each stage always has its own one.
+// Reading returns false if the input is broken: the batches read before are
+// still written out, but the processing stops and false is returned.
+template<class Batch, class ReadOp, class CorrectOp, class WriteOp>
+bool ProcessBatches(std::array<Batch, 3> &batches,
+                    ReadOp &&read, CorrectOp &&correct, WriteOp &&write) {
+  std::future<void> writer;
+
+  bool good = read(batches[0]);
+  for (unsigned buffer_no = 0; good; ++buffer_no) {
+    Batch &batch = batches[buffer_no % 3], &next = batches[(buffer_no + 1) % 3];
+    if (!batch.size)
+      break;
+
+    INFO("Prepared batch " << buffer_no << " of " << batch.size << " reads.");
+    std::future<bool> reader = std::async(std::launch::async, [&] { return read(next); });
+    correct(batch);
+    INFO("Processed batch " << buffer_no);
+
+    if (writer.valid())
+      writer.get();
+    writer = std::async(std::launch::async, [&write, &batch, buffer_no] {
+        write(batch);
+        INFO("Written batch " << buffer_no);
+    });
+    good = reader.get();
+  }
+
+  if (writer.valid())
+    writer.get();
+  return good;
+}
+
+}
+
 CorrectionStats CorrectReadFile(const KMerData &data,
                      const std::string &fname,
                      std::ofstream *outf_good, std::ofstream *outf_bad) {
@@ -112,33 +170,38 @@ CorrectionStats CorrectReadFile(const KMerData &data,
 
   unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
   size_t read_buffer_size = correct_nthreads * cfg::get().correct_readbuffer;
-  std::vector<Read> reads(read_buffer_size);
-  std::vector<bool> res(read_buffer_size, false);
+  std::array<ReadBatch, 3> batches{{ ReadBatch(read_buffer_size), ReadBatch(read_buffer_size), ReadBatch(read_buffer_size) }};
 
   ireadstream irs(fname, qvoffset);
   VERIFY(irs.is_open());
 
-  unsigned buffer_no = 0;
   CorrectionStats stats;
-  while (!irs.eof()) {
-    size_t buf_size = 0;
-    for (; buf_size < read_buffer_size && !irs.eof(); ++buf_size) {
-      irs >> reads[buf_size];
-      reads[buf_size].trimNsAndBadQuality(trim_quality);
-    }
-    INFO("Prepared batch " << buffer_no << " of " << buf_size << " reads.");
+  ProcessBatches(batches,
+                 [&] (ReadBatch &batch) {
+                   batch.read(irs, trim_quality);
+                   return true;
+                 },
+                 [&] (ReadBatch &batch) {
+                   stats += CorrectReadsBatch(batch.res, batch.reads, batch.size,
+                                              data);
+                 },
+                 [&] (const ReadBatch &batch) {
+                   for (size_t i = 0; i < batch.size; ++i)
+                     batch.reads[i].print(*(batch.res[i] ? outf_good : outf_bad), qvoffset);
+                 });
+  return stats;
+}
 
-    stats += CorrectReadsBatch(res, reads, buf_size,
-                               data);
+namespace {
+
+struct PairedReadBatch {
+  ReadBatch left, right;
+  size_t size;
+
+  PairedReadBatch(size_t capacity)
+      : left(capacity), right(capacity), size(0) {}
+};
 
-    INFO("Processed batch " << buffer_no);
-    for (size_t i = 0; i < buf_size; ++i) {
-      reads[i].print(*(res[i] ? outf_good : outf_bad), qvoffset);
-    }
-    INFO("Written batch " << buffer_no);
-    ++buffer_no;
-  }
-  return stats;
 }
 
 CorrectionStats CorrectPairedReadFiles(const KMerData &data,
@@ -149,45 +212,43 @@ CorrectionStats CorrectPairedReadFiles(const KMerData &data,
 
   unsigned correct_nthreads = min(cfg::get().correct_nthreads, cfg::get().general_max_nthreads);
   size_t read_buffer_size = correct_nthreads * cfg::get().correct_readbuffer;
-  std::vector<Read> l(read_buffer_size);
-  std::vector<Read> r(read_buffer_size);
-  std::vector<bool> left_res(read_buffer_size, false);
-  std::vector<bool> right_res(read_buffer_size, false);
-
-  unsigned buffer_no = 0;
+  std::array<PairedReadBatch, 3> batches{{ PairedReadBatch(read_buffer_size), PairedReadBatch(read_buffer_size), PairedReadBatch(read_buffer_size) }};
 
   ireadstream irsl(fnamel, qvoffset), irsr(fnamer, qvoffset);
   VERIFY(irsl.is_open()); VERIFY(irsr.is_open());
   CorrectionStats stats;
 
-  while (!irsl.eof() && !irsr.eof()) {
-    size_t buf_size = 0;
-    for (; buf_size < read_buffer_size && !irsl.eof() && !irsr.eof(); ++buf_size) {
-      irsl >> l[buf_size]; irsr >> r[buf_size];
-      l[buf_size].trimNsAndBadQuality(trim_quality);
-      r[buf_size].trimNsAndBadQuality(trim_quality);
-    }
-    INFO("Prepared batch " << buffer_no << " of " << buf_size << " reads.");
-
-    stats += CorrectReadsBatch(left_res, l, buf_size,
-                      data);
-    stats += CorrectReadsBatch(right_res, r, buf_size,
-                      data);
-
-    INFO("Processed batch " << buffer_no);
-    for (size_t i = 0; i < buf_size; ++i) {
-      if (left_res[i] && right_res[i]) {
-        l[i].print(*ofcorl, qvoffset);
-        r[i].print(*ofcorr, qvoffset);
-      } else {
-        l[i].print(*(left_res[i] ? ofunp : ofbadl), qvoffset);
-        r[i].print(*(right_res[i] ? ofunp : ofbadr), qvoffset);
-      }
-    }
-    INFO("Written batch " << buffer_no);
-    ++buffer_no;
-  }
-  if (!irsl.eof() || !irsr.eof())
+  bool equal = ProcessBatches(batches,
+                              [&] (PairedReadBatch &batch) {
+                                // Both files are parsed at once
+                                std::future<void> left = std::async(std::launch::async, [&] {
+                                    batch.left.read(irsl, trim_quality);
+                                });
+                                batch.right.read(irsr, trim_quality);
+                                left.get();
+                                batch.size = batch.left.size;
+                                return batch.left.size == batch.right.size;
+                              },
+                              [&] (PairedReadBatch &batch) {
+                                stats += CorrectReadsBatch(batch.left.res, batch.left.reads, batch.size,
+                                                           data);
+                                stats += CorrectReadsBatch(batch.right.res, batch.right.reads, batch.size,
+                                                           data);
+                              },
+                              [&] (const PairedReadBatch &batch) {
+                                const auto &l = batch.left.reads, &r = batch.right.reads;
+                                const auto &left_res = batch.left.res, &right_res = batch.right.res;
+                                for (size_t i = 0; i < batch.size; ++i) {
+                                  if (left_res[i] && right_res[i]) {
+                                    l[i].print(*ofcorl, qvoffset);
+                                    r[i].print(*ofcorr, qvoffset);
+                                  } else {
+                                    l[i].print(*(left_res[i] ? ofunp : ofbadl), qvoffset);
+                                    r[i].print(*(right_res[i] ? ofunp : ofbadr), qvoffset);
+                                  }
+                                }
+                              });
+  if (!equal || !irsl.eof() || !irsr.eof())
       FATAL_ERROR("Pair of read files " + fnamel + " and " + fnamer + " contain unequal amount of reads");
   return stats;
 }
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 
 using std::max_element;
@@ -453,7 +454,7 @@ static void UpdateErrors(numeric::matrix<uint64_t> &m,
 
 size_t KMerClustering::ProcessCluster(const std::vector<size_t> &cur_class,
                                       numeric::matrix<uint64_t> &errs,
-                                      std::ofstream &ofs, std::ofstream &ofs_bad,
+                                      std::ostream *ofs, std::ostream *ofs_bad,
                                       size_t &gsingl, size_t &tsingl, size_t &tcsingl, size_t &gcsingl,
                                       size_t &tcls, size_t &gcls, size_t &tkmers, size_t &tncls) {
     size_t newkmers = 0;
@@ -466,24 +467,16 @@ size_t KMerClustering::ProcessCluster(const std::vector<size_t> &cur_class,
             singl.mark_good();
             gsingl += 1;
 
-            if (ofs.good()) {
-#               pragma omp critical
-                {
-                    ofs << " good singleton: " << idx << "\n  " << singl << '\n';
-                }
-            }
+            if (ofs)
+                *ofs << " good singleton: " << idx << "\n  " << singl << '\n';
         } else {
             if (cfg::get().correct_use_threshold && (1-singl.total_qual) > cfg::get().correct_threshold)
                 singl.mark_good();
             else
                 singl.mark_bad();
 
-            if (ofs_bad.good()) {
-#               pragma omp critical
-                {
-                    ofs_bad << " bad singleton: " << idx << "\n  " << singl << '\n';
-                }
-            }
+            if (ofs_bad)
+                *ofs_bad << " bad singleton: " << idx << "\n  " << singl << '\n';
         }
         tsingl += 1;
         return 0;
@@ -533,25 +526,17 @@ size_t KMerClustering::ProcessCluster(const std::vector<size_t> &cur_class,
           else
               gcls += 1;
 
-          if (ofs.good()) {
-#             pragma omp critical
-              {
-                  ofs << " center of good cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
-                  << center << '\n';
-              }
-          }
+          if (ofs)
+              *ofs << " center of good cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
+                   << center << '\n';
         } else {
             if (cfg::get().correct_use_threshold && center_quality > cfg::get().correct_threshold)
                 center.mark_good();
             else
                 center.mark_bad();
-            if (ofs_bad.good()) {
-#               pragma omp critical
-                {
-                    ofs_bad << " center of bad cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
-                            << center << '\n';
-                }
-            }
+            if (ofs_bad)
+                *ofs_bad << " center of bad cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
+                         << center << '\n';
         }
 
         tkmers += currentBlock.size();
@@ -562,13 +547,9 @@ size_t KMerClustering::ProcessCluster(const std::vector<size_t> &cur_class,
 
             UpdateErrors(errs, data_.kmer(eidx), ckmer);
 
-            if (ofs_bad.good()) {
-#               pragma omp critical
-                {
-                    ofs_bad << " part of cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
-                            << kms << '\n';
-                }
-            }
+            if (ofs_bad)
+                *ofs_bad << " part of cluster (" << currentBlock.size() << ", " << cluster_quality << ")" << "\n  "
+                         << kms << '\n';
         }
     }
 
@@ -586,6 +567,31 @@ public:
   }
 };
 
+// Per-thread buffer for the k-mer output, written to the file in large pieces
+class KMerOutputBuffer {
+  std::ofstream *ofs_;
+  std::ostringstream buf_;
+
+ public:
+  KMerOutputBuffer(std::ofstream &ofs)
+      : ofs_(ofs.is_open() ? &ofs : nullptr) {}
+
+  std::ostream *stream() {
+    return ofs_ ? &buf_ : nullptr;
+  }
+
+  void flush(size_t threshold = 0) {
+    if (!ofs_ || (size_t)buf_.tellp() <= threshold)
+      return;
+
+#   pragma omp critical(kmer_output)
+    {
+      *ofs_ << buf_.str();
+    }
+    buf_.str("");
+  }
+};
+
 void KMerClustering::process(const std::string &Prefix) {
   size_t newkmers = 0;
   size_t gsingl = 0, tsingl = 0, tcsingl = 0, gcsingl = 0, tcls = 0, gcls = 0, tkmers = 0, tncls = 0;
@@ -598,43 +604,69 @@ void KMerClustering::process(const std::string &Prefix) {
 
   // Open and read index file
   MMappedRecordReader<size_t> findex(Prefix + ".idx",  /* unlink */ !debug_, -1ULL);
+  // The clusters themselves are mapped as a whole as well
+  MMappedRecordReader<size_t> fclusters(Prefix, /* unlink */ !debug_, -1ULL);
+
+  size_t nclusters = findex.size();
+  std::vector<size_t> offsets(nclusters + 1, 0);
+  for (size_t i = 0; i < nclusters; ++i)
+    offsets[i + 1] = offsets[i] + findex[i];
+  VERIFY(offsets.back() == fclusters.size());
+
+  // Split the clusters into batches of similar total size. The clusters larger
+  // than the batch size go as separate batches ahead of all the others.
+  size_t batch_size = offsets.back() / (16 * nthreads_) + 1;
+  std::vector<std::pair<size_t, size_t>> batches;
+  for (size_t i = 0; i < nclusters; ++i) {
+    if (findex[i] >= batch_size)
+      batches.emplace_back(i, i + 1);
+  }
+  std::sort(batches.begin(), batches.end(),
+            [&](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+              return findex[a.first] > findex[b.first];
+            });
+  size_t giant = batches.size();
+  for (size_t i = 0; i < nclusters; ) {
+    if (findex[i] >= batch_size) {
+      i += 1;
+      continue;
+    }
+    size_t j = i;
+    for (size_t total = 0; j < nclusters && findex[j] < batch_size && total < batch_size; ++j)
+      total += findex[j];
+    batches.emplace_back(i, j);
+    i = j;
+  }
+  INFO("Processing " << nclusters << " clusters in " << batches.size() << " batches, " << giant << " of them are single large clusters");
 
   std::vector<numeric::matrix<uint64_t> > errs(nthreads_, numeric::matrix<double>(4, 4, 0.0));
 
-# pragma omp parallel for shared(ofs, ofs_bad, errs) num_threads(nthreads_) schedule(guided) reduction(+:newkmers, gsingl, tsingl, tcsingl, gcsingl, tcls, gcls, tkmers, tncls)
-  for (size_t chunk = 0; chunk < nthreads_ * nthreads_; ++chunk) {
-      size_t *current = findex.data() + findex.size() * chunk / nthreads_ / nthreads_;
-      size_t *next = findex.data() + findex.size() * (chunk + 1)/ nthreads_ / nthreads_;
-      std::ifstream is(Prefix, std::ios::in | std::ios::binary);
-
-      // Calculate how much we need to seek
-      size_t soff = 0;
-      for (size_t *csz = findex.data(); csz != current; ++csz)
-          soff += *csz;
-
-      // Now see the stream and start processing
-      is.seekg(soff * sizeof(size_t));
-
-      for (; current != next; ++current) {
-          std::vector<size_t> cluster(*current);
-          VERIFY(is.good());
-          is.read((char*)&cluster[0], *current * sizeof(cluster[0]));
-
-          // Underlying code expected classes to be sorted in count decreasing order.
-          std::sort(cluster.begin(), cluster.end(), KMerStatCountComparator(data_));
-
-          newkmers += ProcessCluster(cluster,
-                                     errs[omp_get_thread_num()],
-                                     ofs, ofs_bad,
-                                     gsingl, tsingl, tcsingl, gcsingl,
-                                     tcls, gcls, tkmers, tncls);
+# pragma omp parallel num_threads(nthreads_) reduction(+:newkmers, gsingl, tsingl, tcsingl, gcsingl, tcls, gcls, tkmers, tncls)
+  {
+    const size_t output_threshold = 1 << 20;
+    KMerOutputBuffer good_output(ofs), bad_output(ofs_bad);
+    std::vector<size_t> cluster;
+
+#   pragma omp for schedule(dynamic, 1)
+    for (size_t batch = 0; batch < batches.size(); ++batch) {
+      for (size_t i = batches[batch].first; i < batches[batch].second; ++i) {
+        cluster.assign(fclusters.data() + offsets[i], fclusters.data() + offsets[i + 1]);
+
+        // Underlying code expected classes to be sorted in count decreasing order.
+        std::sort(cluster.begin(), cluster.end(), KMerStatCountComparator(data_));
+
+        newkmers += ProcessCluster(cluster,
+                                   errs[omp_get_thread_num()],
+                                   good_output.stream(), bad_output.stream(),
+                                   gsingl, tsingl, tcsingl, gcsingl,
+                                   tcls, gcls, tkmers, tncls);
       }
-  }
+      good_output.flush(output_threshold);
+      bad_output.flush(output_threshold);
+    }
 
-  if (!debug_) {
-      int res = unlink(Prefix.c_str());
-      VERIFY_MSG(res == 0,
-                 "unlink(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+    good_output.flush();
+    bad_output.flush();
   }
 
   for (unsigned i = 1; i < nthreads_; ++i)
@@ -60,7 +60,7 @@ private:
 
   size_t ProcessCluster(const std::vector<size_t> &cur_class,
                         boost::numeric::ublas::matrix<uint64_t> &errs,
-                        std::ofstream &ofs, std::ofstream &ofs_bad,
+                        std::ostream *ofs, std::ostream *ofs_bad,
                         size_t &gsingl, size_t &tsingl, size_t &tcsingl, size_t &gcsingl,
                         size_t &tcls, size_t &gcls, size_t &tkmers, size_t &tncls);
 
@@ -61,10 +61,10 @@ class BufferFiller {
   BufferFiller(HammerFilteringKMerSplitter &splitter)
       : splitter_(splitter) {}
 
-  bool operator()(std::unique_ptr<Read> r) {
+  bool operator()(const Read &r) {
     int trim_quality = cfg::get().input_trim_quality;
 
-    Read cr = *r;
+    Read cr = r;
     size_t sz = cr.trimNsAndBadQuality(trim_quality);
   
     if (sz < hammer::K)
@@ -96,12 +96,13 @@ HammerFilteringKMerSplitter::RawKMers HammerFilteringKMerSplitter::Split(size_t
   for (const auto &reads : cfg::get().dataset.reads()) {
     INFO("Processing " << reads);
     ireadstream irs(reads, cfg::get().input_qvoffset);
-    while (!irs.eof()) {
-      hammer::ReadProcessor rp(nthreads);
+    hammer::ReadProcessor rp(nthreads);
+    while (!irs.eof() || rp.pending()) {
+      size_t prev = rp.processed();
       rp.Run(irs, filler);
       DumpBuffers(out);
       VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
-      processed += rp.processed();
+      processed += rp.processed() - prev;
 
       if (processed >> n) {
         INFO("Processed " << processed << " reads");
@@ -160,11 +161,11 @@ class KMerDataFiller {
   KMerDataFiller(KMerData &data)
       : data_(data) {}
 
-  bool operator()(std::unique_ptr<Read> r) {
+  bool operator()(const Read &r) {
     uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
     // FIXME: Get rid of this
-    Read cr = *r;
+    Read cr = r;
     size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
     if (sz < hammer::K)
@@ -195,11 +196,11 @@ class KMerMultiplicityCounter {
 
   ~KMerMultiplicityCounter() {}
 
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
       uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
       // FIXME: Get rid of this
-      Read cr = *r;
+      Read cr = r;
       size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
       if (sz < hammer::K)
@@ -233,11 +234,11 @@ class KMerCountEstimator {
 
   ~KMerCountEstimator() {}
 
-    bool operator()(std::unique_ptr<Read> r) {
+    bool operator()(const Read &r) {
       uint8_t trim_quality = (uint8_t)cfg::get().input_trim_quality;
 
       // FIXME: Get rid of this
-      Read cr = *r;
+      Read cr = r;
       size_t sz = cr.trimNsAndBadQuality(trim_quality);
 
       if (sz < hammer::K)
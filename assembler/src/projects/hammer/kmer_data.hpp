@@ -10,6 +10,7 @@
 
 #include "kmer_stat.hpp"
 #include "adt/array_vector.hpp"
+#include "io/kmers/mmapped_reader.hpp"
 
 #include "utils/kmer_mph/kmer_index.hpp"
 #include "utils/logger/logger.hpp"
@@ -27,7 +28,7 @@ class KMerData {
   KMerData()
       : kmers_(nullptr, 0, hammer::KMer::GetDataSize(hammer::K)) {}
 
-  ~KMerData() { delete[] kmers_.data(); }
+  ~KMerData() { free_kmers(); }
 
   size_t size() const { return kmers_.size() + push_back_buffer_.size(); }
 
@@ -77,25 +78,36 @@ class KMerData {
   const KMerStat& operator[](hammer::KMer s) const { return operator[](seq_idx(s)); }
   size_t seq_idx(hammer::KMer s) const { return index_.seq_idx(s); }
 
+  // The k-mers go to an aligned offset right before the index, so binary_read
+  // maps them from the file instead of reading them into memory.
   template <class Writer>
   void binary_write(Writer &os) {
+    size_t pos = 0;
     size_t sz = data_.size();
     os.write((char*)&sz, sizeof(sz));
     os.write((char*)&data_[0], sz*sizeof(data_[0]));
+    pos += sizeof(sz) + sz*sizeof(data_[0]);
 
     sz = push_back_buffer_.size();
     os.write((char*)&sz, sizeof(sz));
     os.write((char*)&push_back_buffer_[0], sz*sizeof(push_back_buffer_[0]));
     os.write((char*)&kmer_push_back_buffer_[0], sz*sizeof(kmer_push_back_buffer_[0]));
+    pos += sizeof(sz) + sz*(sizeof(push_back_buffer_[0]) + sizeof(kmer_push_back_buffer_[0]));
 
-    index_.serialize(os);
     sz = kmers_.size();
     os.write((char*)&sz, sizeof(sz));
+    pos += 2 * sizeof(pos);
+    size_t offset = (pos + KMERS_ALIGNMENT - 1) / KMERS_ALIGNMENT * KMERS_ALIGNMENT;
+    os.write((char*)&offset, sizeof(offset));
+    std::vector<char> padding(offset - pos, 0);
+    os.write(padding.data(), padding.size());
     os.write((char*)kmers_.data(), sz * sizeof(hammer::KMer::DataType) * hammer::KMer::GetDataSize(hammer::K));
+
+    index_.serialize(os);
   }
 
   template <class Reader>
-  void binary_read(Reader &is, const std::string &) {
+  void binary_read(Reader &is, const std::string &fname) {
     clear();
 
     size_t sz = 0;
@@ -109,15 +121,36 @@ class KMerData {
     kmer_push_back_buffer_.resize(sz);
     is.read((char*)&kmer_push_back_buffer_[0], sz*sizeof(kmer_push_back_buffer_[0]));
 
-    index_.deserialize(is);
+    size_t offset = 0;
     is.read((char*)&sz, sizeof(sz));
+    is.read((char*)&offset, sizeof(offset));
+    size_t kmers_bytes = sz * sizeof(hammer::KMer::DataType) * hammer::KMer::GetDataSize(hammer::K);
+    is.seekg(offset + kmers_bytes);
+    index_.deserialize(is);
+
+    // The k-mers are never modified after the index is built
+    free_kmers();
+    if (kmers_bytes)
+      kmers_mapping_ = MMappedReader(fname, /* unlink */ false, -1ULL, (off_t)offset, kmers_bytes);
     kmers_.set_size(sz);
-    kmers_.set_data(new hammer::KMer::DataType[sz * hammer::KMer::GetDataSize(hammer::K)]);
-    is.read((char*)kmers_.data(), sz * sizeof(hammer::KMer::DataType) * hammer::KMer::GetDataSize(hammer::K));
+    kmers_.set_data((hammer::KMer::DataType*)kmers_mapping_.data());
   }
 
  private:
+  // Covers the page size of any platform we run on
+  static const size_t KMERS_ALIGNMENT = 1 << 16;
+
+  void free_kmers() {
+    if (kmers_mapping_.data())
+      kmers_mapping_ = MMappedReader();
+    else
+      delete[] kmers_.data();
+    kmers_.set_data(nullptr);
+    kmers_.set_size(0);
+  }
+
   adt::array_vector<hammer::KMer::DataType> kmers_;
+  MMappedReader kmers_mapping_;
 
   KMerDataStorageType data_;
   KMerStorageType kmer_push_back_buffer_;
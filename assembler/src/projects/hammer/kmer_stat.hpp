@@ -35,10 +35,11 @@ typedef Seq<K> KMer;
 class Read;
 struct KMerStat;
 
-static inline unsigned hamdistKMer(const hammer::KMer &x, const hammer::KMer &y,
-                                   unsigned tau = hammer::K) {
+template<size_t size_>
+static inline unsigned hamdistKMer(const Seq<size_> &x, const Seq<size_> &y,
+                                   unsigned tau = size_) {
   unsigned dist = 0;
-  for (unsigned i = 0; i < hammer::K; ++i) {
+  for (unsigned i = 0; i < size_; ++i) {
     if (x[i] != y[i]) {
       ++dist; if (dist > tau) return dist;
     }
@@ -46,6 +47,26 @@ static inline unsigned hamdistKMer(const hammer::KMer &x, const hammer::KMer &y,
   return dist;
 }
 
+// Number of differing nucleotides of two k-mers: a nucleotide differs iff any
+// of its two bits is set in XOR of the packed k-mers
+template<size_t size_>
+static inline unsigned hamdistPacked(const Seq<size_> &x, const Seq<size_> &y) {
+  typedef Seq<size_> KMer;
+  static_assert(sizeof(typename KMer::DataType) == sizeof(uint64_t), "Unexpected k-mer storage");
+
+  const size_t tail = size_ % KMer::TNucl;
+  const uint64_t tail_mask = tail ? (1ULL << (2 * tail)) - 1 : ~0ULL;
+
+  unsigned dist = 0;
+  for (size_t i = 0; i < KMer::DataSize; ++i) {
+    uint64_t diff = x.data()[i] ^ y.data()[i];
+    if (i + 1 == KMer::DataSize)
+      diff &= tail_mask;
+    dist += __builtin_popcountll((diff | (diff >> 1)) & 0x5555555555555555ULL);
+  }
+  return dist;
+}
+
 template<unsigned N, unsigned bits,
          typename Storage = uint64_t>
 class NibbleString {
@@ -53,6 +53,21 @@ struct UfCmp {
   }
 };
 
+static void DumpKMerData(const char *name) {
+  INFO("Debug mode on. Dumping K-mer index");
+  std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, name);
+  std::ofstream os(fname.c_str(), std::ios::binary);
+  Globals::kmer_data->binary_write(os);
+}
+
+static void LoadKMerData(const char *name) {
+  INFO("Reading K-mer index");
+  std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, name);
+  std::ifstream is(fname.c_str(), std::ios::binary);
+  VERIFY(is.good());
+  Globals::kmer_data->binary_read(is, fname);
+}
+
 void create_console_logger() {
   using namespace logging;
 
@@ -118,31 +133,29 @@ int main(int argc, char * argv[]) {
     for (Globals::iteration_no = 0; Globals::iteration_no < max_iterations; ++Globals::iteration_no) {
       std::cout << "\n     === ITERATION " << Globals::iteration_no << " begins ===" << std::endl;
       bool do_everything = cfg::get().general_do_everything_after_first_iteration && (Globals::iteration_no > 0);
+      bool do_count = cfg::get().count_do || do_everything;
+      bool do_hamming = cfg::get().hamming_do || do_everything;
+      bool do_bayes = cfg::get().bayes_do || do_everything;
+      bool do_expand = cfg::get().expand_do || do_everything;
+      bool do_correct = cfg::get().correct_do || do_everything;
 
       // initialize k-mer structures
       Globals::kmer_data = new KMerData;
 
-      // count k-mers
-      if (cfg::get().count_do || do_everything) {
+      // The k-mer data stays in memory between the steps. The dump of a skipped step
+      // is loaded only if some of the following steps uses it before the next load.
+      if (do_count) {
         KMerDataCounter(cfg::get().count_numfiles).BuildKMerIndex(*Globals::kmer_data);
 
-        if (cfg::get().general_debug) {
-          INFO("Debug mode on. Dumping K-mer index");
-          std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index");
-          std::ofstream os(fname.c_str(), std::ios::binary);
-          Globals::kmer_data->binary_write(os);
-        }
-      } else {
-        INFO("Reading K-mer index");
-        std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index");
-        std::ifstream is(fname.c_str(), std::ios::binary);
-        VERIFY(is.good());
-        Globals::kmer_data->binary_read(is, fname);
+        if (cfg::get().general_debug)
+          DumpKMerData("kmer.index");
+      } else if (do_hamming || do_bayes) {
+        LoadKMerData("kmer.index");
       }
 
       // Cluster the Hamming graph
       std::vector<std::vector<size_t> > classes;
-      if (cfg::get().hamming_do || do_everything) {
+      if (do_hamming) {
         dsu::ConcurrentDSU uf(Globals::kmer_data->size());
         std::string ham_prefix = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmers.hamcls");
         INFO("Clustering Hamming graph.");
@@ -167,7 +180,7 @@ int main(int argc, char * argv[]) {
         INFO("Clustering done. Total clusters: " << num_classes);
       }
 
-      if (cfg::get().bayes_do || do_everything) {
+      if (do_bayes) {
         KMerDataCounter(cfg::get().count_numfiles).FillKMerData(*Globals::kmer_data);
 
         INFO("Subclustering Hamming graph");
@@ -177,32 +190,29 @@ int main(int argc, char * argv[]) {
         kmc.process(hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmers.hamming"));
         INFO("Finished clustering.");
 
-        if (cfg::get().general_debug) {
-          INFO("Debug mode on. Dumping K-mer index");
-          std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index2");
-          std::ofstream os(fname.c_str(), std::ios::binary);
-          Globals::kmer_data->binary_write(os);
-        }
-      } else {
-        INFO("Reading K-mer index");
-        std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index2");
-        std::ifstream is(fname.c_str(), std::ios::binary);
-        VERIFY(is.good());
-        Globals::kmer_data->binary_read(is, fname);
+        if (cfg::get().general_debug)
+          DumpKMerData("kmer.index2");
+      } else if (do_expand) {
+        LoadKMerData("kmer.index2");
       }
 
       // expand the set of solid k-mers
-      if (cfg::get().expand_do || do_everything) {
+      if (do_expand) {
         unsigned expand_nthreads = std::min(cfg::get().general_max_nthreads, cfg::get().expand_nthreads);
         INFO("Starting solid k-mers expansion in " << expand_nthreads << " threads.");
+        Expander expander(*Globals::kmer_data, expand_nthreads);
         for (unsigned expand_iter_no = 0; expand_iter_no < cfg::get().expand_max_iterations; ++expand_iter_no) {
-          Expander expander(*Globals::kmer_data);
-          const io::DataSet<> &dataset = cfg::get().dataset;
-          for (auto I = dataset.reads_begin(), E = dataset.reads_end(); I != E; ++I) {
-            ireadstream irs(*I, cfg::get().input_qvoffset);
-            hammer::ReadProcessor rp(expand_nthreads);
-            rp.Run(irs, expander);
-            VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
+          if (expand_iter_no == 0) {
+            const io::DataSet<> &dataset = cfg::get().dataset;
+            for (auto I = dataset.reads_begin(), E = dataset.reads_end(); I != E; ++I) {
+              ireadstream irs(*I, cfg::get().input_qvoffset);
+              hammer::ReadProcessor rp(expand_nthreads);
+              rp.Run(irs, expander);
+              VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
+            }
+            INFO(expander.candidates() << " reads are kept for the next iterations.");
+          } else {
+            expander.ExpandCandidates();
           }
 
           if (cfg::get().expand_write_each_iteration) {
@@ -221,23 +231,15 @@ int main(int argc, char * argv[]) {
         }
         INFO("Solid k-mers finalized");
 
-        if (cfg::get().general_debug) {
-          INFO("Debug mode on. Dumping K-mer index");
-          std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index3");
-          std::ofstream os(fname.c_str(), std::ios::binary);
-          Globals::kmer_data->binary_write(os);
-        }
-      } else {
-        INFO("Reading K-mer index");
-        std::string fname = hammer::getFilename(cfg::get().input_working_dir, Globals::iteration_no, "kmer.index3");
-        std::ifstream is(fname.c_str(), std::ios::binary);
-        VERIFY(is.good());
-        Globals::kmer_data->binary_read(is, fname);
+        if (cfg::get().general_debug)
+          DumpKMerData("kmer.index3");
+      } else if (do_correct) {
+        LoadKMerData("kmer.index3");
       }
 
       size_t totalReads = 0;
       // reconstruct and output the reads
-      if (cfg::get().correct_do || do_everything) {
+      if (do_correct) {
         totalReads = hammer::CorrectAllReads();
       }
 
@@ -43,8 +43,8 @@ class BufferFiller {
 
   size_t processed() const { return processed_; }
 
-  bool operator()(std::unique_ptr<io::SingleRead> r) {
-    ValidHKMerGenerator<hammer::K> gen(*r);
+  bool operator()(const io::SingleRead &r) {
+    ValidHKMerGenerator<hammer::K> gen(r);
     unsigned thread_id = omp_get_thread_num();
 
 #pragma omp atomic
@@ -75,7 +75,7 @@ HammerKMerSplitter::RawKMers HammerKMerSplitter::Split(size_t num_files, unsigne
     INFO("Processing " << reads);
     io::FileReadStream irs(reads, io::PhredOffset);
     hammer::ReadProcessor rp(nthreads);
-    while (!irs.eof()) {
+    while (!irs.eof() || rp.pending()) {
       rp.Run(irs, filler);
       DumpBuffers(out);
       VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
@@ -130,8 +130,8 @@ class KMerDataFiller {
     return UniformRandGenerator(RandomEngine);
   }
 
-  bool operator()(std::unique_ptr<io::SingleRead> &&r) const {
-    ValidHKMerGenerator<hammer::K> gen(*r);
+  bool operator()(const io::SingleRead &r) const {
+    ValidHKMerGenerator<hammer::K> gen(r);
 
     // tiny quality regularization
     const double decay = 0.9999;
@@ -59,22 +59,19 @@ class ParallelSortingSplitter : public utils::KMerSortingSplitter<RtSeq> {
 
       size_t processed() const { return processed_; }
 
-      bool operator()(std::unique_ptr<io::SingleRead> r) {
+      bool operator()(const io::SingleRead &r) {
 #         pragma omp atomic
           processed_ += 1;
 
-          const Sequence &seq = r->sequence();
+          const Sequence &seq = r.sequence();
 
           if (seq.size() < this->K_)
               return false;
 
           unsigned thread_id = omp_get_thread_num();
           bool stop = false;
-          RtSeq kmer = seq.start<RtSeq>(this->K_) >> 'A';
-          for (size_t j = this->K_ - 1; j < seq.size(); ++j) {
-              kmer <<= seq[j];
-              stop |= splitter_.push_back_internal(kmer, thread_id);
-          }
+          for (RollingKMerIterator<RtSeq> it(seq, this->K_); it.good(); it.next(seq))
+              stop |= splitter_.push_back_internal(it.fwd_data(), thread_id);
 
           return stop;
       }
@@ -98,8 +95,8 @@ class ParallelSortingSplitter : public utils::KMerSortingSplitter<RtSeq> {
         for (const auto &file : files_) {
             INFO("Processing " << file);
             auto irs = io::EasyStream(file, true, true);
-            while (!irs.eof()) {
-                hammer::ReadProcessor rp(nthreads);
+            hammer::ReadProcessor rp(nthreads);
+            while (!irs.eof() || rp.pending()) {
                 rp.Run(irs, filler);
                 DumpBuffers(out);
                 VERIFY_MSG(rp.read() == rp.processed(), "Queue unbalanced");
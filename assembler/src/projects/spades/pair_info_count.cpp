@@ -23,6 +23,7 @@ namespace debruijn_graph {
 typedef io::SequencingLibrary<config::LibraryData> SequencingLib;
 using PairedInfoFilter = bf::counting_bloom_filter<std::pair<EdgeId, EdgeId>, 2>;
 using EdgePairCounter = hll::hll_with_hasher<std::pair<EdgeId, EdgeId>>;
+using MappingCacheT = SequenceMapperNotifier::MappingCacheT;
 
 std::shared_ptr<SequenceMapper<Graph>> ChooseProperMapper(const conj_graph_pack& gp,
                                                           const SequencingLib& library) {
@@ -81,13 +82,20 @@ class EdgePairCounterFiller : public SequenceMapperListener {
     }
 
   public:
-    EdgePairCounterFiller(size_t thread_num)
-            : counter_(EdgePairHash) {
-        buf_.reserve(thread_num);
-        for (unsigned i = 0; i < thread_num; ++i)
+    EdgePairCounterFiller()
+            : counter_(EdgePairHash) {}
+
+    void StartProcessLibrary(size_t buffers_count) override {
+        buf_.clear();
+        buf_.reserve(buffers_count);
+        for (size_t i = 0; i < buffers_count; ++i)
           buf_.emplace_back(EdgePairHash);
     }
 
+    void StopProcessLibrary() override {
+        buf_.clear();
+    }
+
     void MergeBuffer(size_t i) override {
         counter_.merge(buf_[i]);
         buf_[i].clear();
@@ -186,10 +194,12 @@ static bool ShouldObtainSingleReadsPaths(size_t ilib) {
 
 static bool CollectLibInformation(const conj_graph_pack &gp,
                                   size_t &edgepairs,
-                                  size_t ilib, size_t edge_length_threshold) {
+                                  size_t ilib, size_t edge_length_threshold,
+                                  const SequenceMapper<Graph> &mapper,
+                                  MappingCacheT &mapping_cache) {
     INFO("Estimating insert size (takes a while)");
     InsertSizeCounter hist_counter(gp, edge_length_threshold);
-    EdgePairCounterFiller pcounter(cfg::get().max_threads);
+    EdgePairCounterFiller pcounter;
 
     SequenceMapperNotifier notifier(gp, cfg::get_writable().ds.reads.lib_count());
     notifier.Subscribe(ilib, &hist_counter);
@@ -200,7 +210,7 @@ static bool CollectLibInformation(const conj_graph_pack &gp,
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, /*insert_size*/0,
                                                 /*include_merged*/true);
 
-    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads));
+    notifier.ProcessLibrary(paired_streams, ilib, mapper, mapping_cache);
     //Check read length after lib processing since mate pairs a not used until this step
     VERIFY(reads.data().unmerged_read_length != 0);
 
@@ -271,7 +281,9 @@ static void ProcessSingleReads(conj_graph_pack &gp,
 static void ProcessPairedReads(conj_graph_pack &gp,
                                std::unique_ptr<PairedInfoFilter> filter,
                                unsigned filter_threshold,
-                               size_t ilib) {
+                               size_t ilib,
+                               const SequenceMapper<Graph> &mapper,
+                               MappingCacheT &mapping_cache) {
     SequencingLib &reads = cfg::get_writable().ds.reads[ilib];
     const auto &data = reads.data();
 
@@ -307,7 +319,7 @@ static void ProcessPairedReads(conj_graph_pack &gp,
 
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, (size_t) data.mean_insert_size,
                                                 /*include merged*/true);
-    notifier.ProcessLibrary(paired_streams, ilib, *ChooseProperMapper(gp, reads));
+    notifier.ProcessLibrary(paired_streams, ilib, mapper, mapping_cache);
 }
 
 void PairInfoCount::run(conj_graph_pack &gp, const char *) {
@@ -335,8 +347,14 @@ void PairInfoCount::run(conj_graph_pack &gp, const char *) {
                 size_t rl = lib_data.unmerged_read_length;
                 size_t k = cfg::get().K;
 
+                // All the passes over the paired reads below use the same mapper,
+                // so the read mapping is done once and then replayed from the cache
+                auto mapper_ptr = ChooseProperMapper(gp, lib);
+                MappingCacheT mapping_cache(gp.g, lib.data().binary_reads_info.paired_read_prefix + "_mapping");
+
                 size_t edgepairs = 0;
-                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold)) {
+                if (!CollectLibInformation(gp, edgepairs, i, edge_length_threshold,
+                                           *mapper_ptr, mapping_cache)) {
                     cfg::get_writable().ds.reads[i].data().mean_insert_size = 0.0;
                     WARN("Unable to estimate insert size for paired library #" << i);
                     if (rl > 0 && rl <= k) {
@@ -378,14 +396,15 @@ void PairInfoCount::run(conj_graph_pack &gp, const char *) {
 
                         VERIFY(lib.data().unmerged_read_length != 0);
                         auto reads = paired_binary_readers(lib, /*followed by rc*/false, 0, /*include merged*/true);
-                        notifier.ProcessLibrary(reads, i, *ChooseProperMapper(gp, lib));
+                        notifier.ProcessLibrary(reads, i, *mapper_ptr, mapping_cache);
                     }
                 }
 
                 INFO("Mapping library #" << i);
                 if (lib.data().mean_insert_size != 0.0) {
                     INFO("Mapping paired reads (takes a while) ");
-                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i);
+                    ProcessPairedReads(gp, std::move(filter), filter_threshold, i,
+                                       *mapper_ptr, mapping_cache);
                 }
             }
 
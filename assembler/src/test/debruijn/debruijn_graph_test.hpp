@@ -10,6 +10,11 @@
 #include <boost/test/unit_test.hpp>
 
 #include "test_utils.hpp"
+#include "graphio.hpp"
+#include "assembly_graph/graph_support/edge_removal.hpp"
+
+#include <map>
+#include <set>
 
 namespace debruijn_graph {
 
@@ -227,6 +232,131 @@ BOOST_AUTO_TEST_CASE( TestSelfRCEdgeMerge ) {
     BOOST_CHECK_EQUAL(Sequence("AACGCTATTCACGTGAATAGCGTT"), g.EdgeNucls(g.GetUniqueOutgoingEdge(v1)));
 }
 
+// Records the events as the sequences of the edges involved
+class EventRecorder : public omnigraph::GraphActionHandler<Graph> {
+    typedef omnigraph::GraphActionHandler<Graph> base;
+
+    std::string str(EdgeId e) const {
+        return this->g().EdgeNucls(e).str();
+    }
+
+public:
+    std::multiset<std::string> added, deleted, merges;
+    size_t deleted_vertices = 0, merge_batches = 0;
+
+    EventRecorder(const Graph &g)
+            : base(g, "EventRecorder") {}
+
+    using base::HandleAdd;
+    using base::HandleDelete;
+
+    void HandleAdd(EdgeId e) override {
+        added.insert(str(e));
+    }
+
+    void HandleDelete(EdgeId e) override {
+        deleted.insert(str(e));
+    }
+
+    void HandleDelete(VertexId) override {
+        deleted_vertices += 1;
+    }
+
+    void HandleMerge(const std::vector<EdgeId> &old_edges, EdgeId new_edge) override {
+        std::string merge;
+        for (EdgeId e : old_edges)
+            merge += str(e) + " ";
+        merges.insert(merge + "-> " + str(new_edge));
+    }
+
+    void HandleMergeBatch(const std::vector<omnigraph::MergeEvent<EdgeId>> &merges) override {
+        merge_batches += 1;
+        base::HandleMergeBatch(merges);
+    }
+};
+
+// Tips with the localities (ends and their neighbours) not intersecting each other
+static std::vector<EdgeId> DisjointTips(const Graph &g) {
+    std::set<VertexId> reserved;
+    std::vector<EdgeId> tips;
+    for (EdgeId e : g.edges()) {
+        VertexId start = g.EdgeStart(e), end = g.EdgeEnd(e);
+        if (e != g.conjugate(e) && g.conjugate(e) < e)
+            continue;
+        if (!g.IsDeadEnd(end) || g.IncomingEdgeCount(end) != 1 || g.OutgoingEdgeCount(start) < 2)
+            continue;
+
+        std::vector<VertexId> locality = { start, end };
+        for (EdgeId in : g.IncomingEdges(start))
+            locality.push_back(g.EdgeStart(in));
+        for (EdgeId out : g.OutgoingEdges(start))
+            locality.push_back(g.EdgeEnd(out));
+        for (VertexId &v : locality)
+            v = std::min(v, g.conjugate(v));
+        if (std::any_of(locality.begin(), locality.end(), [&](VertexId v) { return reserved.count(v); }))
+            continue;
+
+        reserved.insert(locality.begin(), locality.end());
+        tips.push_back(e);
+    }
+    return tips;
+}
+
+static std::map<std::string, double> EdgeCoverage(const Graph &g) {
+    std::map<std::string, double> coverage;
+    for (EdgeId e : g.edges())
+        coverage[g.EdgeNucls(e).str()] = g.coverage(e);
+    return coverage;
+}
+
+BOOST_AUTO_TEST_CASE( DeferredEventsBatch ) {
+    std::string path = "./src/test/debruijn/graph_fragments/tips/graph";
+    Graph immediate(55), deferred(55);
+    graphio::ScanBasicGraph(path, immediate);
+    graphio::ScanBasicGraph(path, deferred);
+    EventRecorder immediate_events(immediate), deferred_events(deferred);
+
+    std::vector<EdgeId> tips = DisjointTips(immediate);
+    BOOST_REQUIRE(tips.size() > 1);
+    for (EdgeId e : tips)
+        BOOST_REQUIRE_EQUAL(immediate.EdgeNucls(e), deferred.EdgeNucls(e));
+
+    omnigraph::EdgeRemover<Graph> immediate_remover(immediate), deferred_remover(deferred);
+    for (EdgeId e : tips)
+        immediate_remover.DeleteEdge(e);
+
+    // Every tip is removed as if by a separate thread, removal could merge two edges at most
+    std::vector<Graph::DeferredEvents> events(tips.size());
+    auto ids = deferred.FreeEdgeIds(4 * tips.size());
+    for (size_t i = 0; i < tips.size(); ++i) {
+        events[i].set_edge_ids(ids.begin() + 4 * i, ids.begin() + 4 * (i + 1));
+        deferred.StartDeferring(events[i]);
+        deferred_remover.DeleteEdge(tips[i]);
+        deferred.StopDeferring();
+    }
+    BOOST_CHECK(deferred_events.deleted.empty());
+    BOOST_CHECK(deferred_events.merges.empty());
+    deferred.FireDeferred(events);
+
+    BOOST_CHECK_EQUAL(deferred_events.merge_batches, 1u);
+    BOOST_CHECK(!deferred_events.merges.empty());
+    BOOST_CHECK(deferred_events.merges == immediate_events.merges);
+    BOOST_CHECK(deferred_events.deleted == immediate_events.deleted);
+    BOOST_CHECK_EQUAL(deferred_events.deleted_vertices, immediate_events.deleted_vertices);
+
+    // Edges merged once again within the batch are not reported as added
+    std::multiset<std::string> added = immediate_events.added;
+    for (const auto &e : immediate_events.deleted) {
+        auto it = added.find(e);
+        if (it != added.end())
+            added.erase(it);
+    }
+    BOOST_CHECK(deferred_events.added == added);
+
+    BOOST_CHECK_EQUAL(deferred.size(), immediate.size());
+    BOOST_CHECK(EdgeCoverage(deferred) == EdgeCoverage(immediate));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
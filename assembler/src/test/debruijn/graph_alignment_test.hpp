@@ -10,6 +10,9 @@
 
 #include "assembly_graph/core/graph.hpp"
 #include "modules/alignment/sequence_mapper.hpp"
+#include "modules/alignment/mapping_cache.hpp"
+#include "modules/alignment/kmer_map.hpp"
+#include "utils/filesystem/temporary.hpp"
 
 #include "io/reads/io_helper.hpp"
 #include "common/assembly_graph/core/coverage.hpp"
@@ -200,6 +203,158 @@ BOOST_AUTO_TEST_CASE( DijkstraGrowEndsTest ) {
     BOOST_CHECK_EQUAL(ideal_score, score);
 }
 
+BOOST_AUTO_TEST_CASE( MappingCacheRoundTrip ) {
+    typedef Graph::EdgeId EdgeId;
+    fs::make_dirs("tmp");
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    Graph g(55);
+
+    // Edge ids and positions go back and forth, so the deltas are negative
+    // as well; large values take the longest varints
+    std::vector<MappingPath<EdgeId>> paths;
+    paths.emplace_back();
+    paths.emplace_back(std::vector<EdgeId>{ EdgeId(42) },
+                       std::vector<MappingRange>{ MappingRange(0, 100, 10, 110) });
+    paths.emplace_back(std::vector<EdgeId>{ EdgeId(1ull << 40), EdgeId(7), EdgeId(1ull << 40), EdgeId(-1ull) },
+                       std::vector<MappingRange>{ MappingRange(5, 60, 0, 55),
+                                                  MappingRange(60, 61, 1ull << 33, (1ull << 33) + 1),
+                                                  MappingRange(61, 200, 300, 400),   // deletion
+                                                  MappingRange(210, 300, 0, 95) });  // insertion
+    paths.emplace_back(std::vector<EdgeId>{ EdgeId(3), EdgeId(2) },
+                       std::vector<MappingRange>{ MappingRange(0, 50, 10, 60, 0.5),
+                                                  MappingRange(50, 100, 0, 50, 1.0) });
+
+    MappingCache<Graph> cache(g, workdir->dir() + "/cache");
+    BOOST_CHECK(!cache.valid(2));
+    cache.Open(2);
+    for (size_t i = 0; i < 2; ++i)
+        for (const auto &path : paths)
+            cache.stream(i).Map([&] { return path; });
+    cache.Close();
+    BOOST_CHECK(cache.valid(2));
+    BOOST_CHECK(!cache.valid(3));
+
+    cache.Open(2);
+    for (size_t i = 0; i < 2; ++i) {
+        for (const auto &path : paths) {
+            auto replayed = cache.stream(i).Map([&] {
+                BOOST_ERROR("Path is mapped instead of replay");
+                return MappingPath<EdgeId>();
+            });
+            BOOST_REQUIRE_EQUAL(replayed.size(), path.size());
+            for (size_t j = 0; j < path.size(); ++j) {
+                BOOST_CHECK_EQUAL(replayed.edge_at(j).int_id(), path.edge_at(j).int_id());
+                BOOST_CHECK(replayed.mapping_at(j).initial_range == path.mapping_at(j).initial_range);
+                BOOST_CHECK(replayed.mapping_at(j).mapped_range == path.mapping_at(j).mapped_range);
+                BOOST_CHECK_EQUAL(replayed.mapping_at(j).quality, path.mapping_at(j).quality);
+            }
+        }
+    }
+    cache.Close();
+
+    // Any graph change invalidates the cache
+    g.AddEdge(g.AddVertex(), g.AddVertex(), Sequence(std::string(60, 'A')));
+    BOOST_CHECK(!cache.valid(2));
+}
+
+static RtSeq RandomKmer(unsigned k, std::mt19937 &rnd) {
+    std::string s(k, 'A');
+    for (auto &c : s)
+        c = nucl((char)(rnd() % 4));
+    return RtSeq(k, s.c_str());
+}
+
+static void CheckKMerMap(const KMerMap &map, const std::map<RtSeq, RtSeq> &etalon,
+                         const std::vector<RtSeq> &erased) {
+    BOOST_CHECK_EQUAL(map.size(), etalon.size());
+    for (const auto &entry : etalon) {
+        BOOST_CHECK(map.count(entry.first));
+        const auto *value = map.find(entry.first);
+        BOOST_REQUIRE(value);
+        BOOST_CHECK_EQUAL(RtSeq(entry.second.size(), value), entry.second);
+    }
+    for (const auto &kmer : erased) {
+        if (!etalon.count(kmer)) {
+            BOOST_CHECK(!map.count(kmer));
+            BOOST_CHECK(!map.find(kmer));
+        }
+    }
+
+    std::map<RtSeq, RtSeq> iterated;
+    for (const auto &entry : map)
+        BOOST_CHECK(iterated.insert(entry).second);
+    BOOST_CHECK(iterated == etalon);
+}
+
+BOOST_AUTO_TEST_CASE( KMerMapEraseAndRehash ) {
+    // Single- and multi-word k-mers
+    for (unsigned k : { 21u, 55u }) {
+        std::mt19937 rnd(k);
+        KMerMap map(k);
+        std::map<RtSeq, RtSeq> etalon;
+        std::vector<RtSeq> keys, erased;
+
+        // Growth from the empty table through several rehashes
+        for (size_t i = 0; i < 5000; ++i) {
+            RtSeq key = RandomKmer(k, rnd), value = RandomKmer(k, rnd);
+            map.set(key, value);
+            etalon[key] = value;
+            keys.push_back(key);
+        }
+        CheckKMerMap(map, etalon, erased);
+
+        // Overwriting the values keeps the size
+        for (size_t i = 0; i < keys.size(); i += 3) {
+            RtSeq value = RandomKmer(k, rnd);
+            map.set(keys[i], value);
+            etalon[keys[i]] = value;
+        }
+        CheckKMerMap(map, etalon, erased);
+
+        // Erased keys leave tombstones, the probe chains must go past them
+        for (size_t i = 0; i < keys.size(); i += 2) {
+            map.erase(keys[i]);
+            etalon.erase(keys[i]);
+            erased.push_back(keys[i]);
+        }
+        map.erase(RandomKmer(k, rnd));
+        CheckKMerMap(map, etalon, erased);
+
+        // Erased keys are inserted again, tombstones are reused
+        for (size_t i = 0; i < erased.size(); i += 5) {
+            map.set(erased[i], erased[i]);
+            etalon[erased[i]] = erased[i];
+        }
+        CheckKMerMap(map, etalon, erased);
+
+        // Churn with the constant size, so the rehashes are triggered by the tombstones only
+        for (size_t round = 0; round < 20; ++round) {
+            for (size_t i = 0; i < 500; ++i) {
+                RtSeq key = RandomKmer(k, rnd);
+                map.set(key, key);
+                etalon[key] = key;
+                keys.push_back(key);
+            }
+            for (size_t i = 0; i < 500; ++i) {
+                const RtSeq &key = keys[keys.size() - 1 - 2 * i];
+                map.erase(key);
+                etalon.erase(key);
+                erased.push_back(key);
+            }
+        }
+        CheckKMerMap(map, etalon, erased);
+
+        map.reserve(2 * etalon.size());
+        CheckKMerMap(map, etalon, erased);
+
+        map.clear();
+        etalon.clear();
+        CheckKMerMap(map, etalon, erased);
+        map.set(keys[0], keys[1]);
+        etalon[keys[0]] = keys[1];
+        CheckKMerMap(map, etalon, erased);
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
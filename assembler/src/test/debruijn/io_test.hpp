@@ -13,6 +13,9 @@
 #include "io/binary/graph.hpp"
 #include "io/binary/kmer_mapper.hpp"
 #include "io/binary/paired_index.hpp"
+#include "io/reads/binary_converter.hpp"
+#include "io/reads/binary_streams.hpp"
+#include "io/reads/vector_reader.hpp"
 
 #include <boost/test/unit_test.hpp>
 
@@ -101,6 +104,35 @@ BOOST_AUTO_TEST_CASE(TestPairedInfoIO) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(TestFrozenPairedInfoIO) {
+    using namespace omnigraph::de;
+    using Index = UnclusteredPairedInfoIndexT<Graph>;
+    using FrozenIndex = FrozenUnclusteredPairedInfoIndexT<Graph>;
+    const auto &graph = CommonGraph();
+
+    Index pi(graph);
+    RandomPairedIndex<Index>(pi, 100).Generate(100);
+    FrozenIndex fi(graph);
+    fi.Build(pi);
+
+    Save(file_name, fi);
+
+    FrozenIndex ni(graph);
+    Load(file_name, ni);
+
+    BOOST_CHECK_EQUAL(fi.size(), ni.size());
+    for (auto pit = omnigraph::de::pair_begin(pi); pit != omnigraph::de::pair_end(pi); ++pit) {
+        auto nh = ni.Get(pit.first(), pit.second());
+        BOOST_CHECK_EQUAL(pit->size(), nh.size());
+
+        auto npit = nh.begin();
+        for (auto ppit = pit->begin(); ppit != pit->end(); ++ppit, ++npit) {
+            BOOST_CHECK_EQUAL(ppit->weight, npit->weight);
+            BOOST_CHECK_EQUAL(ppit->d, npit->d);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestKmerMapperIO) {
     const auto &graph = CommonGraph();
 
@@ -115,5 +147,48 @@ BOOST_AUTO_TEST_CASE(TestKmerMapperIO) {
     CompareContainers(kmer_mapper, new_mapper);
 }
 
+BOOST_AUTO_TEST_CASE(TestBinaryReadStreamPortions) {
+    // Several chunks of reads with varying lengths, so the portion
+    // boundaries are not page-aligned
+    std::vector<io::SingleReadSeq> reads;
+    for (size_t i = 0; i < 1234; ++i)
+        reads.emplace_back(RandomSequence(50 + i % 200), i % 7, i % 5);
+
+    {
+        io::BinaryWriter writer(file_name);
+        io::ReadStream<io::SingleReadSeq> stream{io::VectorReadStream<io::SingleReadSeq>(reads)};
+        writer.ToBinary(stream);
+    }
+
+    for (size_t portions : { 1, 3, 7, 20 }) {
+        std::vector<io::SingleReadSeq> loaded;
+        for (size_t i = 0; i < portions; ++i) {
+            io::BinaryFileSingleStream stream(file_name, portions, i);
+            io::SingleReadSeq read;
+            while (!stream.eof()) {
+                stream >> read;
+                loaded.push_back(read);
+            }
+        }
+
+        BOOST_REQUIRE_EQUAL(loaded.size(), reads.size());
+        for (size_t i = 0; i < reads.size(); ++i) {
+            BOOST_CHECK_EQUAL(loaded[i].sequence(), reads[i].sequence());
+            BOOST_CHECK_EQUAL(loaded[i].GetLeftOffset(), reads[i].GetLeftOffset());
+            BOOST_CHECK_EQUAL(loaded[i].GetRightOffset(), reads[i].GetRightOffset());
+        }
+    }
+
+    // Truncated records are detected before anything is copied
+    std::ostringstream os;
+    reads.back().BinWrite(os);
+    std::string record = os.str();
+    io::SingleReadSeq read;
+    BOOST_CHECK(read.BinRead(record.data(), record.data() + record.size()) == record.data() + record.size());
+    BOOST_CHECK_EQUAL(read.sequence(), reads.back().sequence());
+    for (size_t len : { size_t(0), size_t(4), size_t(20), record.size() - 1 })
+        BOOST_CHECK(read.BinRead(record.data(), record.data() + len) == nullptr);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
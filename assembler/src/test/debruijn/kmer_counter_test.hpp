@@ -0,0 +1,169 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/kmer_mph/kmer_index_builder.hpp"
+#include "utils/ph_map/storing_traits.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "io/reads/read_stream_vector.hpp"
+#include "utils/filesystem/path_helper.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <random>
+#include <set>
+
+namespace debruijn_graph {
+
+BOOST_AUTO_TEST_SUITE(kmer_counter_tests)
+
+static std::vector<io::SingleReadSeq> RandomReads(size_t n, size_t len, unsigned seed) {
+    std::mt19937 rnd(seed);
+    std::vector<io::SingleReadSeq> reads;
+    for (size_t i = 0; i < n; ++i) {
+        std::string s(len, 'A');
+        for (auto &c : s)
+            c = nucl((char)(rnd() % 4));
+        reads.emplace_back(Sequence(s));
+        // Duplicate reads produce repeated k-mers within and across the runs
+        if (i % 3 == 0)
+            reads.emplace_back(Sequence(s));
+    }
+    return reads;
+}
+
+static std::vector<std::vector<RtSeq::DataType>> CountKMers(utils::KMerCounter<RtSeq> &counter,
+                                                            unsigned nthreads) {
+    counter.CountAll(nthreads, nthreads, /* merge */false);
+
+    std::vector<std::vector<RtSeq::DataType>> res;
+    for (unsigned i = 0; i < counter.num_buckets(); ++i) {
+        auto bucket = counter.GetBucket(i);
+        res.emplace_back((const RtSeq::DataType*)bucket->data(),
+                         (const RtSeq::DataType*)bucket->data() + bucket->data_size() / sizeof(RtSeq::DataType));
+    }
+    return res;
+}
+
+static void WriteRaw(const std::string &fname, const std::vector<size_t> &data) {
+    std::ofstream ofs(fname, std::ios::out | std::ios::binary);
+    ofs.write((const char*)data.data(), data.size() * sizeof(size_t));
+}
+
+static std::vector<RtSeq::DataType> ReadRaw(const std::string &fname) {
+    std::ifstream ifs(fname, std::ios::in | std::ios::binary);
+    std::vector<RtSeq::DataType> res;
+    RtSeq::DataType val;
+    while (ifs.read((char*)&val, sizeof(val)))
+        res.push_back(val);
+    return res;
+}
+
+BOOST_AUTO_TEST_CASE( RunMergerUnsortedAndDuplicated ) {
+    // Single word k-mers, so they could be written as plain integers
+    const unsigned K = 21;
+    BOOST_REQUIRE_EQUAL(RtSeq::GetDataSize(K), 1u);
+    fs::make_dirs("tmp");
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    std::mt19937 rnd(42);
+
+    std::string unsorted_file = workdir->dir() + "/unsorted", runs_file = workdir->dir() + "/runs";
+
+    // Splitter output without an index is a single unsorted run
+    std::vector<size_t> unsorted;
+    for (size_t i = 0; i < 5000; ++i)
+        unsorted.push_back(rnd() % 1000);
+    WriteRaw(unsorted_file, unsorted);
+
+    // Sorted runs overlapping with each other
+    std::vector<size_t> runs, index;
+    for (size_t r = 0; r < 5; ++r) {
+        std::vector<size_t> run;
+        for (size_t i = 0; i < 700; ++i)
+            run.push_back(rnd() % 2000);
+        std::sort(run.begin(), run.end());
+        runs.insert(runs.end(), run.begin(), run.end());
+        index.push_back(run.size());
+    }
+    WriteRaw(runs_file, runs);
+    WriteRaw(runs_file + ".idx", index);
+
+    // Small ranges make the merger partition the inputs
+    utils::KMerRunMerger<RtSeq> merger(K, 64 * sizeof(RtSeq::DataType));
+    std::vector<utils::KMerRunMerger<RtSeq>::RunSet> inputs(2);
+    merger.LoadRuns(unsorted_file, inputs[0]);
+    merger.LoadRuns(runs_file, inputs[1]);
+    std::vector<std::string> outputs = { workdir->dir() + "/out.0", workdir->dir() + "/out.1" };
+    size_t kmers = merger.Merge(inputs, outputs, 2);
+
+    std::set<size_t> etalon0(unsorted.begin(), unsorted.end()), etalon1(runs.begin(), runs.end());
+    BOOST_CHECK_EQUAL(kmers, etalon0.size() + etalon1.size());
+    BOOST_CHECK(ReadRaw(outputs[0]) == std::vector<RtSeq::DataType>(etalon0.begin(), etalon0.end()));
+    BOOST_CHECK(ReadRaw(outputs[1]) == std::vector<RtSeq::DataType>(etalon1.begin(), etalon1.end()));
+}
+
+BOOST_AUTO_TEST_CASE( MemoryBucketsBudget ) {
+    const unsigned K = 21;
+    typedef utils::KMerMemoryBuckets<RtSeq> Buckets;
+    const size_t el_size = RtSeq::GetDataSize(K) * sizeof(RtSeq::DataType);
+    std::vector<RtSeq::DataType> run(8 * RtSeq::GetDataSize(K), 0);
+
+    // 4 k-mers fit, growing to 8 needs both the old and the new storage at once
+    Buckets buckets(K, 2, 11 * el_size);
+    BOOST_CHECK(buckets.append(0, run.data(), 4));
+    BOOST_CHECK_EQUAL(buckets.used(), 4 * el_size);
+    BOOST_CHECK(!buckets.append(0, run.data(), 4));
+    BOOST_CHECK(buckets.spilled(0));
+    BOOST_CHECK(!buckets.append(0, run.data(), 1));
+    BOOST_CHECK_EQUAL(buckets.runs(0).size(), 1u);
+
+    // Memory charged from outside counts towards the same budget
+    buckets.charge(5 * el_size);
+    BOOST_CHECK(!buckets.append(1, run.data(), 3));
+    BOOST_CHECK(buckets.spilled(1));
+
+    buckets.release(0);
+    buckets.uncharge(5 * el_size);
+    BOOST_CHECK_EQUAL(buckets.used(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( MemoryCounterMatchesDisk ) {
+    typedef io::VectorReadStream<io::SingleReadSeq> RawStream;
+    typedef utils::DeBruijnReadKMerSplitter<io::SingleReadSeq,
+                                            utils::StoringTypeFilter<utils::InvertableStoring>> Splitter;
+    const unsigned K = 22, nthreads = 2;
+    fs::make_dirs("tmp");
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+
+    std::vector<std::vector<RtSeq::DataType>> disk, memory;
+    {
+        io::ReadStreamList<io::SingleReadSeq> streams;
+        for (unsigned i = 0; i < nthreads; ++i)
+            streams.push_back(RawStream(RandomReads(500, 100, i)));
+        Splitter splitter(workdir, K, 0, streams);
+        utils::KMerDiskCounter<RtSeq> counter(workdir, splitter);
+        disk = CountKMers(counter, nthreads);
+    }
+    {
+        io::ReadStreamList<io::SingleReadSeq> streams;
+        for (unsigned i = 0; i < nthreads; ++i)
+            streams.push_back(RawStream(RandomReads(500, 100, i)));
+        Splitter splitter(workdir, K, 0, streams);
+        utils::KMerMemoryCounter<RtSeq> counter(workdir, splitter, /* kmers_estimate */ 100000);
+        memory = CountKMers(counter, nthreads);
+    }
+
+    size_t total = 0;
+    for (const auto &bucket : disk)
+        total += bucket.size();
+    BOOST_CHECK(total > 0);
+    BOOST_CHECK(disk == memory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -8,6 +8,10 @@
 
 #include <boost/test/unit_test.hpp>
 #include "paired_info/paired_info_helpers.hpp"
+#include "paired_info/frozen_paired_index.hpp"
+#include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/distance_estimation.hpp"
+#include "graphio.hpp"
 #include "random_graph.hpp"
 #include "io/binary/paired_index.hpp"
 
@@ -459,6 +463,109 @@ BOOST_AUTO_TEST_CASE(PairedInfoRandomSymmetry) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(PairedInfoFrozen) {
+    MockGraph graph;
+    MockIndex pi(graph);
+    RawPoint p1 = {10, 1}, p2 = {20, 2}, p0 = {0, 1};
+    pi.Add(1, 3, p1);
+    pi.Add(1, 3, p2);
+    pi.Add(1, 9, p2);
+    pi.Add(1, 1, p0);
+
+    FrozenUnclusteredPairedInfoIndexT<MockGraph> fpi(graph);
+    fpi.Build(pi);
+    BOOST_CHECK_EQUAL(fpi.size(), pi.size());
+    BOOST_CHECK(fpi.contains(1, 3));
+    BOOST_CHECK(fpi.contains(4, 2));
+    BOOST_CHECK(!fpi.contains(3, 1));
+    BOOST_CHECK(fpi.contains(8));
+    BOOST_CHECK(!fpi.contains(5));
+    BOOST_CHECK_EQUAL(GetNeighbours(fpi, 1), GetNeighbours(pi, 1));
+    BOOST_CHECK_EQUAL(GetNeighbours(fpi, 2), GetNeighbours(pi, 2));
+    BOOST_CHECK(GetNeighbours(fpi, 13).empty());
+    BOOST_CHECK_EQUAL(fpi.Get(4, 2).Unwrap(), pi.Get(4, 2).Unwrap());
+    BOOST_CHECK_EQUAL(fpi.Get(1, 3).Unwrap(), pi.Get(1, 3).Unwrap());
+    BOOST_CHECK_EQUAL(fpi.Get(8, 2).Unwrap(), pi.Get(8, 2).Unwrap());
+    BOOST_CHECK(fpi.Get(1, 8).empty());
+    BOOST_CHECK(fpi.GetHalf(4)[2].empty());
+    BOOST_CHECK_EQUAL(fpi.GetHalf(1)[3].size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(PairedInfoFrozenRandom) {
+    Graph graph(55);
+    debruijn_graph::RandomGraph<Graph>(graph, /*max_size*/100).Generate(/*iterations*/1000);
+    std::vector<EdgeId> edges(graph.edges().begin(), graph.edges().end());
+
+    TestIndex pi(graph);
+    ConcurrentPairedInfoBuffer<Graph> buffer(graph);
+    for (size_t i = 0; i < 1000; ++i) {
+        EdgeId e1 = edges[rand() % edges.size()], e2 = edges[rand() % edges.size()];
+        RawPoint p(DEDistance(rand() % 100), DEWeight(1));
+        pi.Add(e1, e2, p);
+        buffer.Add(e1, e2, p);
+    }
+
+    FrozenUnclusteredPairedInfoIndexT<Graph> fpi(graph), fbuffer(graph);
+    fpi.Build(pi);
+    fbuffer.Build(buffer);
+    BOOST_CHECK_EQUAL(fpi.size(), pi.size());
+    BOOST_CHECK_EQUAL(fbuffer.size(), pi.size());
+    for (EdgeId e : edges) {
+        size_t neighbours = 0;
+        for (auto i : pi.Get(e)) {
+            BOOST_CHECK_EQUAL(fpi.Get(e, i.first).Unwrap(), i.second.Unwrap());
+            BOOST_CHECK_EQUAL(fbuffer.Get(e, i.first).Unwrap(), i.second.Unwrap());
+            ++neighbours;
+        }
+        BOOST_CHECK_EQUAL(std::distance(fpi.Get(e).begin(), fpi.Get(e).end()), neighbours);
+        BOOST_CHECK_EQUAL(std::distance(fbuffer.Get(e).begin(), fbuffer.Get(e).end()), neighbours);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GraphDistanceCacheConsistency) {
+    using namespace debruijn_graph;
+    Graph g(55);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", g);
+
+    const size_t insert_size = 300, read_length = 100, delta = 10;
+    GraphDistanceFinder finder(g, insert_size, read_length, delta);
+    GraphDistanceCache cache(finder);
+    size_t upper = finder.PathLengthUpperBound();
+
+    std::vector<EdgeId> edges;
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        edges.push_back(*it);
+    std::sort(edges.begin(), edges.end(), [&](EdgeId a, EdgeId b) {
+        return std::make_pair(g.EdgeEnd(a), a) < std::make_pair(g.EdgeEnd(b), b);
+    });
+
+    size_t checked = 0;
+    for (EdgeId e1 : edges) {
+        std::map<EdgeId, std::vector<size_t>> second_edges;
+        for (EdgeId e2 : edges)
+            second_edges[e2];
+        finder.FillGraphDistancesLengths(e1, second_edges, cache);
+
+        for (const auto &entry : second_edges) {
+            EdgeId e2 = entry.first;
+            size_t lower = PairInfoPathLengthLowerBound(g.k(), g.length(e1), g.length(e2),
+                                                        int(insert_size - 2 * read_length), double(delta));
+            DistancesLengthsCallback<Graph> callback(g);
+            ProcessPaths(g, lower, upper, g.EdgeEnd(e1), g.EdgeStart(e2), callback);
+            std::vector<size_t> expected = callback.distances();
+            for (auto &length : expected)
+                length += g.length(e1);
+            if (e1 == e2)
+                expected.insert(expected.begin(), 0);
+
+            BOOST_CHECK_EQUAL_COLLECTIONS(entry.second.begin(), entry.second.end(),
+                                          expected.begin(), expected.end());
+            checked += !expected.empty();
+        }
+    }
+    BOOST_CHECK(checked > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace de
@@ -20,6 +20,9 @@
 #include "test_utils.hpp"
 #include "modules/path_extend/path_visualizer.hpp"
 #include "modules/path_extend/pe_utils.hpp"
+#include "modules/path_extend/path_extender.hpp"
+#include "assembly_graph/graph_support/scaff_supplementary.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 namespace path_extend {
 
 BOOST_FIXTURE_TEST_SUITE(path_extend_basic, fs::TmpFolderFixture)
@@ -765,6 +768,56 @@ BOOST_AUTO_TEST_CASE( BidirectionalPathLoopDetector ) {
 }
 
 
+// Edge sequences and relative ids of the paths grown from every edge by nthreads threads
+static std::vector<std::pair<uint64_t, std::vector<EdgeId>>> GrowFromEdges(conj_graph_pack &gp,
+                                                                     const ScaffoldingUniqueEdgeStorage &unique,
+                                                                     int nthreads) {
+    Graph &g = gp.g;
+    PathContainer seeds;
+    for (auto iter = g.ConstEdgeBegin(/*canonical only*/true); !iter.IsEnd(); ++iter)
+        seeds.AddPair(new BidirectionalPath(g, *iter), new BidirectionalPath(g, g.conjugate(*iter)));
+    seeds.SortByLength();
+
+    GraphCoverageMap cover_map(g);
+    UsedUniqueStorage used_unique(unique, g);
+    auto extender = std::make_shared<SimpleExtender>(gp, cover_map, used_unique,
+                                                     std::make_shared<TrivialExtensionChooser>(g),
+                                                     /*is*/ 300, false, false);
+    CompositeExtender composite(g, cover_map, used_unique, {extender});
+
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(nthreads);
+    PathContainer paths;
+    composite.GrowAll(seeds, paths);
+    omp_set_num_threads(threads);
+
+    std::vector<std::pair<uint64_t, std::vector<EdgeId>>> res;
+    BOOST_REQUIRE(paths.size() > 0);
+    uint64_t first_id = paths.Get(0)->GetId();
+    for (auto iter = paths.begin(); iter != paths.end(); ++iter) {
+        for (const BidirectionalPath *p : {iter.get(), iter.getConjugate()})
+            res.emplace_back(p->GetId() - first_id, std::vector<EdgeId>(p->begin(), p->end()));
+    }
+    return res;
+}
+
+BOOST_AUTO_TEST_CASE( CompositeExtenderSpeculativeGrowth ) {
+    conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanGraphPack("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", gp);
+
+    // Without and with the unique edge check
+    ScaffoldingUniqueEdgeStorage empty, unique;
+    ScaffoldingUniqueEdgeAnalyzer(gp, 500, 0.5).FillUniqueEdgeStorage(unique);
+    BOOST_REQUIRE(unique.size() > 0);
+
+    for (const ScaffoldingUniqueEdgeStorage *storage : {&empty, &unique}) {
+        auto serial = GrowFromEdges(gp, *storage, 1);
+        auto speculative = GrowFromEdges(gp, *storage, 4);
+        BOOST_CHECK(serial == speculative);
+    }
+}
+
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -13,6 +13,7 @@
 #include "stages/simplification_pipeline/graph_simplification.hpp"
 #include "stages/simplification_pipeline/single_cell_simplification.hpp"
 #include "stages/simplification_pipeline/rna_simplification.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include <boost/test/unit_test.hpp>
 //#include "repeat_resolving_routine.hpp"
 
@@ -432,6 +433,62 @@ BOOST_AUTO_TEST_CASE( ParallelECRemover2 ) {
 }
 #endif
 
+typedef std::function<AlgoPtr<Graph>(Graph &, EdgeRemovalHandlerF<Graph>)> RemoverFactoryF;
+
+// Sequences of the edges left and of the ones removed
+static std::pair<std::multiset<std::string>, std::multiset<std::string>>
+RemoveEdges(const std::string &path, RemoverFactoryF factory, unsigned nthreads) {
+    Graph g(55);
+    graphio::ScanBasicGraph(path, g);
+    std::multiset<std::string> removed, left;
+    // The handler is called while the edge is still in the graph
+    auto algo = factory(g, [&](EdgeId e) { removed.insert(g.EdgeNucls(e).str()); });
+
+    int max_threads = omp_get_max_threads();
+    omp_set_num_threads(nthreads);
+    algo->Run();
+    omp_set_num_threads(max_threads);
+
+    for (EdgeId e : g.edges())
+        left.insert(g.EdgeNucls(e).str());
+    return { left, removed };
+}
+
+static void CheckConcurrentRemoval(const std::string &path, RemoverFactoryF factory) {
+    auto serial = RemoveEdges(path, factory, 1);
+    BOOST_CHECK(!serial.second.empty());
+    for (unsigned nthreads : { 2u, 4u }) {
+        auto concurrent = RemoveEdges(path, factory, nthreads);
+        BOOST_CHECK(concurrent.first == serial.first);
+        BOOST_CHECK(concurrent.second == serial.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( ConcurrentTipClipper ) {
+    CheckConcurrentRemoval(graph_fragment_root() + "tips/graph",
+                           [](Graph &g, EdgeRemovalHandlerF<Graph> handler) {
+                               return debruijn::simplification::TipClipperInstance(g, standard_tc_config(),
+                                                                                   standard_simplif_relevant_info(),
+                                                                                   handler);
+                           });
+}
+
+BOOST_AUTO_TEST_CASE( ConcurrentRelativeECRemover ) {
+    // The alternatives presence condition looks beyond the locality of the edge
+    debruijn_config::simplification::relative_coverage_ec_remover rcec_config;
+    rcec_config.enabled = true;
+    rcec_config.max_ec_length = 1000;
+    rcec_config.rcec_ratio = 15.;
+    for (const std::string &path : { graph_fragment_root() + "ecoli_400k/distance_estimation",
+                                     graph_fragment_root() + "rel_cov_ec/constructed_graph" }) {
+        CheckConcurrentRemoval(path, [&](Graph &g, EdgeRemovalHandlerF<Graph> handler) {
+            return debruijn::simplification::RelativeECRemoverInstance(g, rcec_config,
+                                                                       standard_simplif_relevant_info(),
+                                                                       handler);
+        });
+    }
+}
+
 //BOOST_AUTO_TEST_CASE( ComplexTipRemover ) {
 //    string path = "./src/test/debruijn/graph_fragments/ecs/graph";
 //    size_t graph_size = 0;
@@ -20,6 +20,7 @@
 #include "paired_info_test.hpp"
 #include "io_test.hpp"
 #include "graph_alignment_test.hpp"
+#include "kmer_counter_test.hpp"
 
 #define BOOST_TEST_SOURCE
 #include <boost/test/impl/unit_test_main.ipp>
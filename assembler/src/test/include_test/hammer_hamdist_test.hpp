@@ -0,0 +1,44 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "projects/hammer/kmer_stat.hpp"
+#include "sequence/nucl.hpp"
+#include <random>
+#include <string>
+
+template<size_t K>
+static void CheckHamdistPacked(unsigned seed) {
+    std::mt19937 rnd(seed);
+    for (size_t iter = 0; iter < 1000; ++iter) {
+        std::string s(K, 'A');
+        for (auto &c : s)
+            c = nucl((char)(rnd() % 4));
+        std::string t = s;
+        // Few differences, many ones and the last nucleotide only
+        size_t changes = iter % 3 == 0 ? rnd() % 4 : rnd() % K;
+        for (size_t i = 0; i < changes; ++i) {
+            size_t pos = iter % 5 == 0 ? K - 1 : rnd() % K;
+            t[pos] = nucl((char)((dignucl(t[pos]) + 1 + rnd() % 3) % 4));
+        }
+
+        Seq<K> x(s.c_str()), y(t.c_str());
+        BOOST_CHECK_EQUAL(hamdistPacked(x, y), hamdistKMer(x, y));
+        BOOST_CHECK_EQUAL(hamdistPacked(x, x), 0u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestHammerHamdistPacked ) {
+    // Multiples of the nucleotides per storage word and the rest
+    CheckHamdistPacked<hammer::K>(1);
+    CheckHamdistPacked<1>(2);
+    CheckHamdistPacked<31>(3);
+    CheckHamdistPacked<32>(4);
+    CheckHamdistPacked<33>(5);
+    CheckHamdistPacked<64>(6);
+    CheckHamdistPacked<77>(7);
+}
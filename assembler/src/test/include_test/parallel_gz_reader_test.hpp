@@ -0,0 +1,125 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "io/reads/parallel_gz_reader.hpp"
+#include "io/reads/fasta_fastq_gz_parser.hpp"
+#include "utils/filesystem/path_helper.hpp"
+#include "utils/filesystem/temporary.hpp"
+#include <fstream>
+#include <random>
+#include <string>
+#include <zlib.h>
+
+static std::string RandomFastq(size_t nreads, unsigned seed) {
+    std::mt19937 rnd(seed);
+    std::string res;
+    for (size_t i = 0; i < nreads; ++i) {
+        std::string seq(100, 'A');
+        for (auto &c : seq)
+            c = nucl((char)(rnd() % 4));
+        res += "@read_" + std::to_string(i) + "\n" + seq + "\n+\n" + std::string(seq.size(), 'I') + "\n";
+    }
+    return res;
+}
+
+static void WriteFile(const std::string &fname, const std::string &data) {
+    std::ofstream ofs(fname, std::ios::out | std::ios::binary);
+    ofs.write(data.data(), data.size());
+}
+
+// Single gzip member of the data, optionally with the BGZF extra field
+static std::string GzipMember(const std::string &data, bool bgzf) {
+    z_stream strm = {};
+    BOOST_REQUIRE_EQUAL(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    std::string deflated(deflateBound(&strm, data.size()), '\0');
+    strm.next_in = (Bytef*)data.data();
+    strm.avail_in = (unsigned)data.size();
+    strm.next_out = (Bytef*)&deflated[0];
+    strm.avail_out = (unsigned)deflated.size();
+    BOOST_REQUIRE_EQUAL(deflate(&strm, Z_FINISH), Z_STREAM_END);
+    deflated.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    std::string res = { 31, (char)139, 8, 0, 0, 0, 0, 0, 0, (char)255 };
+    if (bgzf) {
+        size_t bsize = 18 + deflated.size() + 8 - 1;
+        res[3] = 4;
+        res += std::string({ 6, 0, 'B', 'C', 2, 0, (char)(bsize & 0xFF), (char)(bsize >> 8) });
+    }
+    res += deflated;
+
+    auto put32 = [&](uint32_t val) {
+        for (unsigned i = 0; i < 4; ++i)
+            res += (char)((val >> (8 * i)) & 0xFF);
+    };
+    put32((uint32_t)crc32(0, (const Bytef*)data.data(), (unsigned)data.size()));
+    put32((uint32_t)data.size());
+    return res;
+}
+
+static std::string GzipMembers(const std::string &data, size_t member_size, bool bgzf) {
+    std::string res;
+    for (size_t pos = 0; pos < data.size(); pos += member_size)
+        res += GzipMember(data.substr(pos, member_size), bgzf);
+    // BGZF end-of-file marker is an empty block
+    if (bgzf)
+        res += GzipMember("", true);
+    return res;
+}
+
+static std::string ReadAll(io::ParallelGzReader &reader, unsigned len) {
+    std::string res;
+    std::vector<char> buf(len);
+    int n;
+    while ((n = reader.read(buf.data(), len)) > 0)
+        res.append(buf.data(), n);
+    return res;
+}
+
+static void CheckRoundTrip(const std::string &fname, const std::string &data, bool bgzf) {
+    for (unsigned len : { 1u, 1000u, 1u << 16, 3u << 20 }) {
+        io::ParallelGzReader reader(fname);
+        BOOST_REQUIRE(reader.is_open());
+        BOOST_CHECK_EQUAL(reader.is_bgzf(), bgzf);
+        BOOST_CHECK(ReadAll(reader, len) == data);
+    }
+
+    io::FastaFastqGzParser parser(fname);
+    io::SingleRead read;
+    size_t cnt = 0;
+    while (!parser.eof()) {
+        parser >> read;
+        BOOST_CHECK_EQUAL(read.name(), "read_" + std::to_string(cnt));
+        cnt += 1;
+    }
+    BOOST_CHECK_EQUAL(cnt, std::count(data.begin(), data.end(), '@'));
+}
+
+BOOST_AUTO_TEST_CASE( TestParallelGzReaderRoundTrip ) {
+    fs::make_dirs("tmp");
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    // Several megabytes, so the data spans many chunks
+    std::string data = RandomFastq(20000, 1);
+
+    std::string plain = workdir->dir() + "/reads.fastq";
+    WriteFile(plain, data);
+    CheckRoundTrip(plain, data, false);
+
+    std::string gzip = workdir->dir() + "/reads.fastq.gz";
+    WriteFile(gzip, GzipMembers(data, data.size(), false));
+    CheckRoundTrip(gzip, data, false);
+
+    // Member boundaries are not aligned with the chunks or the reads
+    std::string multi = workdir->dir() + "/multi.fastq.gz";
+    WriteFile(multi, GzipMembers(data, 300007, false));
+    CheckRoundTrip(multi, data, false);
+
+    std::string bgzf = workdir->dir() + "/reads.fastq.bgz";
+    WriteFile(bgzf, GzipMembers(data, 65280, true));
+    CheckRoundTrip(bgzf, data, true);
+}
@@ -0,0 +1,46 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "adt/radix_heap.hpp"
+#include <cstdlib>
+#include <queue>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE( RadixHeapOrder ) {
+    struct Entry {
+        size_t distance;
+        unsigned tag;
+    };
+    struct KeyOf {
+        size_t operator()(const Entry &e) const { return e.distance; }
+    };
+    struct Cmp {
+        bool operator()(const Entry &a, const Entry &b) const {
+            return std::make_pair(b.distance, b.tag) < std::make_pair(a.distance, a.tag);
+        }
+    };
+
+    adt::radix_heap<Entry, KeyOf, Cmp> heap;
+    std::priority_queue<Entry, std::vector<Entry>, Cmp> expected;
+    size_t last = 0;
+    for (size_t i = 0; i < 100000; ++i) {
+        if (expected.empty() || rand() % 3) {
+            // zero increments emulate zero-length edges
+            Entry e{last + (rand() % 4 ? size_t(rand() % 1000) : 0), unsigned(rand() % 10)};
+            heap.push(e);
+            expected.push(e);
+        } else {
+            BOOST_CHECK_EQUAL(heap.top().distance, expected.top().distance);
+            BOOST_CHECK_EQUAL(heap.top().tag, expected.top().tag);
+            last = expected.top().distance;
+            heap.pop();
+            expected.pop();
+        }
+        BOOST_CHECK_EQUAL(heap.size(), expected.size());
+    }
+}
@@ -0,0 +1,107 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "io/reads/read_processor.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace {
+
+class CountingStream {
+public:
+    typedef size_t ReadT;
+
+    CountingStream(size_t size) : cur_(0), size_(size) {}
+
+    bool eof() const { return cur_ == size_; }
+
+    CountingStream &operator>>(size_t &val) {
+        val = cur_++;
+        return *this;
+    }
+
+private:
+    size_t cur_, size_;
+};
+
+// Requests to stop after every stop_after processed reads
+class StoppingCounter {
+public:
+    StoppingCounter(size_t size, size_t stop_after)
+            : seen_(size), processed_(0), stop_after_(stop_after) {}
+
+    bool operator()(const size_t &r) {
+        seen_[r] += 1;
+        return (processed_.fetch_add(1) + 1) % stop_after_ == 0;
+    }
+
+    const std::vector<std::atomic<unsigned>> &seen() const { return seen_; }
+
+private:
+    std::vector<std::atomic<unsigned>> seen_;
+    std::atomic<size_t> processed_;
+    size_t stop_after_;
+};
+
+struct Squarer {
+    std::unique_ptr<size_t> operator()(const size_t &r) {
+        return r % 3 ? std::unique_ptr<size_t>(new size_t(r * r)) : nullptr;
+    }
+};
+
+struct CollectingWriter {
+    std::vector<size_t> data;
+
+    CollectingWriter &operator<<(size_t val) {
+        data.push_back(val);
+        return *this;
+    }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( TestReadProcessorStopKeepsReads ) {
+    const size_t size = 100000;
+    for (unsigned nthreads : { 1u, 4u }) {
+        CountingStream irs(size);
+        StoppingCounter op(size, 777);
+        hammer::ReadProcessor rp(nthreads, /* batch_size */ 100);
+
+        size_t runs = 0;
+        while (!irs.eof() || rp.pending()) {
+            rp.Run(irs, op);
+            BOOST_CHECK_EQUAL(rp.read(), rp.processed());
+            runs += 1;
+        }
+
+        BOOST_CHECK(runs > 1);
+        BOOST_CHECK_EQUAL(rp.processed(), size);
+        for (size_t i = 0; i < size; ++i)
+            BOOST_CHECK_EQUAL(op.seen()[i], 1u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestReadProcessorOrderedWrite ) {
+    const size_t size = 100000;
+    for (unsigned nthreads : { 1u, 4u }) {
+        CountingStream irs(size);
+        Squarer op;
+        CollectingWriter writer;
+        hammer::ReadProcessor rp(nthreads, /* batch_size */ 10);
+        rp.Run(irs, op, writer);
+
+        std::vector<size_t> etalon;
+        for (size_t i = 0; i < size; ++i)
+            if (i % 3)
+                etalon.push_back(i * i);
+
+        BOOST_CHECK_EQUAL(rp.processed(), size);
+        BOOST_CHECK(writer.data == etalon);
+    }
+}
@@ -0,0 +1,58 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "sequence/rolling_kmers.hpp"
+#include "sequence/rtseq.hpp"
+#include "sequence/sequence.hpp"
+#include "sequence/nucl.hpp"
+#include <random>
+#include <string>
+
+static std::string RandomNucls(size_t len, unsigned seed) {
+    std::mt19937 rnd(seed);
+    std::string s(len, 'A');
+    for (auto &c : s)
+        c = nucl((char)(rnd() % 4));
+    return s;
+}
+
+template<class S>
+static void CheckRollingKMers(const S &seq, const std::string &s, unsigned K) {
+    size_t cnt = 0;
+    for (RollingKMerIterator<RtSeq> it(seq, K); it.good(); it.next(seq), ++cnt) {
+        RtSeq kmer(K, s.substr(it.pos(), K).c_str());
+        BOOST_CHECK_EQUAL(it.pos(), cnt);
+        BOOST_CHECK_EQUAL(it.kmer(), kmer);
+        BOOST_CHECK_EQUAL(it.rc(), !kmer);
+        BOOST_CHECK_EQUAL(it.is_minimal(), kmer.IsMinimal());
+        BOOST_CHECK_EQUAL(it.canonical(), kmer.IsMinimal() ? kmer : !kmer);
+        BOOST_CHECK_EQUAL(it.hash(), RtSeq::hash()(kmer));
+        BOOST_CHECK_EQUAL(it.hash(42), RtSeq::hash()(kmer, 42));
+        BOOST_CHECK_EQUAL(it.canonical_hash(42), RtSeq::hash()(kmer.IsMinimal() ? kmer : !kmer, 42));
+    }
+    BOOST_CHECK_EQUAL(cnt, s.size() >= K ? s.size() - K + 1 : 0);
+}
+
+BOOST_AUTO_TEST_CASE( TestRollingKMersMatchRtSeq ) {
+    // Word boundaries and the odd k-mer sizes used for graph construction
+    for (unsigned K : { 1u, 2u, 21u, 31u, 32u, 33u, 55u, 63u, 64u, 65u, 77u, 127u }) {
+        std::string s = RandomNucls(300, K);
+        CheckRollingKMers(s, s, K);
+        CheckRollingKMers(Sequence(s), s, K);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestRollingKMersPalindromes ) {
+    // Palindromic k-mers are equal to their reverse complement
+    std::string s = "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT";
+    for (unsigned K : { 4u, 32u, 64u })
+        CheckRollingKMers(s, s, K);
+
+    // Sequence shorter than k has no k-mers
+    CheckRollingKMers(std::string("ACGT"), std::string("ACGT"), 21);
+}
@@ -16,6 +16,11 @@
 #include "nucl_test.hpp"
 #include "cyclic_hash_test.hpp"
 #include "binary_test.hpp"
+#include "rolling_kmers_test.hpp"
+#include "read_processor_test.hpp"
+#include "parallel_gz_reader_test.hpp"
+#include "radix_heap_test.hpp"
+#include "hammer_hamdist_test.hpp"
 
 #define BOOST_TEST_SOURCE
 #include <boost/test/impl/unit_test_main.ipp>